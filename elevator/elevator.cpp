@@ -15,9 +15,97 @@
 #include <iomanip>
 #include <ctime>
 #include <fstream>
+#include <climits>
+#include <memory>
+#include <cstdio>
+#include <functional>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <filesystem>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 默认启动 gzip 进程压缩和读取轮转出的日志段, 参数直接传给 gzip, 不经过 shell,
+// 直接 g++ elevator.cpp -pthread 即可编译; 以 -DELEVATOR_HAVE_ZLIB 编译并链接 -lz 时改用 zlib
+#ifdef ELEVATOR_HAVE_ZLIB
+#include <zlib.h>
+#else
+#include <cerrno>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
 
 using namespace std;
 
+// 控制台输出级别: 高于 ELEVATOR_LOG_LEVEL 的输出在编译时整体去掉, 不产生任何开销
+// 例如 -DELEVATOR_LOG_LEVEL=1 只保留警告
+#define ELEVATOR_LOG_LEVEL_NONE 0
+#define ELEVATOR_LOG_LEVEL_WARN 1  // 紧急停止、超载、看门狗等需要人注意的事件
+#define ELEVATOR_LOG_LEVEL_INFO 2  // 收到请求、到达、开关门、乘客进出等逐事件输出
+#ifndef ELEVATOR_LOG_LEVEL
+#define ELEVATOR_LOG_LEVEL ELEVATOR_LOG_LEVEL_INFO
+#endif
+
+// 控制台输出: 整行格式化后一次写出, 各线程的输出不会交错, 也不逐行刷新;
+// 安静模式下 INFO 级别在运行时跳过, 热路径上不做任何控制台 I/O
+class ConsoleLog {
+private:
+    static inline atomic<bool> quiet{false};
+    static inline atomic<bool> json{false};
+    
+public:
+    static void setQuiet(bool enabled) { quiet = enabled; }
+    static bool isQuiet() { return quiet.load(memory_order_relaxed) || isJson(); }
+    
+    // JSON 行模式: 事件和状态以 JSON 行写到标准输出, 文字信息只保留警告, 改写到标准错误
+    static void setJson(bool enabled) { json = enabled; }
+    static bool isJson() { return json.load(memory_order_relaxed); }
+    
+    // 提示、命令反馈和统计等文字输出; JSON 行模式下标准输出只留给 JSON
+    static ostream& stream() { return isJson() ? cerr : cout; }
+    
+    // 本线程复用的行缓冲区
+    static ostringstream& beginLine() {
+        static thread_local ostringstream line;
+        line.str("");
+        return line;
+    }
+    
+    static void endLine(ostringstream& line) {
+        line << '\n';
+        string text = line.str();
+        stream().write(text.data(), text.size());
+    }
+};
+
+#define ELEVATOR_CONSOLE_LINE(expr) \
+    do { ostringstream& elevatorConsoleLine = ConsoleLog::beginLine(); elevatorConsoleLine << expr; ConsoleLog::endLine(elevatorConsoleLine); } while (0)
+
+// 去掉的输出不求值, 但仍做类型检查, 其中用到的变量也不会被报告为未使用
+#define ELEVATOR_CONSOLE_DISCARD(expr) do { (void)sizeof(ConsoleLog::beginLine() << expr); } while (0)
+
+#if ELEVATOR_LOG_LEVEL >= ELEVATOR_LOG_LEVEL_WARN
+#define ELEVATOR_LOG_WARN(expr) ELEVATOR_CONSOLE_LINE(expr)
+#else
+#define ELEVATOR_LOG_WARN(expr) ELEVATOR_CONSOLE_DISCARD(expr)
+#endif
+
+#if ELEVATOR_LOG_LEVEL >= ELEVATOR_LOG_LEVEL_INFO
+#define ELEVATOR_LOG_INFO(expr) do { if (!ConsoleLog::isQuiet()) ELEVATOR_CONSOLE_LINE(expr); } while (0)
+#else
+#define ELEVATOR_LOG_INFO(expr) ELEVATOR_CONSOLE_DISCARD(expr)
+#endif
+
 // 电梯状态枚举
 enum class ElevatorState {
     IDLE,
@@ -28,6 +116,29 @@ enum class ElevatorState {
     MAINTENANCE
 };
 
+// JSON 输出中使用的状态名
+inline const char* elevatorStateName(ElevatorState state) {
+    switch (state) {
+        case ElevatorState::IDLE: return "idle";
+        case ElevatorState::MOVING_UP: return "moving_up";
+        case ElevatorState::MOVING_DOWN: return "moving_down";
+        case ElevatorState::DOORS_OPEN: return "doors_open";
+        case ElevatorState::EMERGENCY_STOP: return "emergency_stop";
+        case ElevatorState::MAINTENANCE: return "maintenance";
+    }
+    return "unknown";
+}
+
+// Elevator::mtx 的加锁位置, 分别统计争用情况
+enum class LockSite {
+    REQUEST_FLOOR,          // requestFloor 收件箱满时的加锁登记
+    CONTROL,                // 控制逻辑推进状态机
+    GET_INTERNAL_REQUESTS,  // getInternalRequests (状态输出、派梯)
+    GET_EXTERNAL_REQUESTS,  // getExternalRequests
+    OTHER,                  // 撤销请求、井道让行等
+    COUNT
+};
+
 // 电梯请求类型枚举
 enum class RequestType {
     INTERNAL,    // 电梯内部按钮
@@ -46,738 +157,4616 @@ struct ElevatorRequest {
         : floor(f), timestamp(time(nullptr)), type(t), isEmergency(emergency) {}
 };
 
-// 电梯类
-class Elevator {
+// 定长块内存池: 按块大小从大块内存中切分, 释放的块挂回空闲链表复用
+// 非线程安全, 由使用者加锁
+class FixedBlockPool {
 private:
-    int id;
-    int currentFloor;
-    ElevatorState state;
-    int maxFloors;
-    int capacity;
-    int currentPassengers;
-    bool doorOpen;
-    bool overloaded;
-    set<int> internalRequests;  // 内部按钮请求
-    map<int, pair<bool, bool>> externalRequests; // 外部请求: floor -> (upPressed, downPressed)
-    mutex mtx;
-    condition_variable cv;
-    atomic<bool> running;
-    atomic<bool> emergencyStop;
-    atomic<bool> maintenanceMode;
-    string logFile;
+    struct FreeBlock {
+        FreeBlock* next;
+    };
     
-    // 统计信息
-    int totalTrips;
-    int totalFloorsTraveled;
-    time_t startTime;
-    time_t lastMaintenance;
+    size_t blockSize;
+    size_t blocksPerChunk;
+    FreeBlock* freeList;
+    vector<unique_ptr<char[]>> chunks;
+    size_t inUse;
     
-    void logEvent(const string& event) {
-        ofstream log(logFile, ios::app);
-        if (log.is_open()) {
-            time_t now = time(nullptr);
-            char timeStr[100];
-            strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-            log << "[" << timeStr << "] 电梯 " << id << ": " << event << endl;
+    void grow() {
+        chunks.emplace_back(new char[blockSize * blocksPerChunk]);
+        char* base = chunks.back().get();
+        for (size_t i = 0; i < blocksPerChunk; i++) {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(base + i * blockSize);
+            block->next = freeList;
+            freeList = block;
         }
     }
     
 public:
-    Elevator(int id, int maxFloors, int capacity, const string& logFilename = "") 
-        : id(id), currentFloor(1), state(ElevatorState::IDLE), maxFloors(maxFloors), 
-          capacity(capacity), currentPassengers(0), doorOpen(false), overloaded(false),
-          running(true), emergencyStop(false), maintenanceMode(false),
-          totalTrips(0), totalFloorsTraveled(0), startTime(time(nullptr)), lastMaintenance(time(nullptr)) {
-        
-        if (logFilename.empty()) {
-            ostringstream ss;
-            ss << "elevator_" << id << ".log";
-            logFile = ss.str();
-        } else {
-            logFile = logFilename;
-        }
-        
-        // 清空日志文件
-        ofstream log(logFile, ios::trunc);
-        log << "电梯 " << id << " 日志开始" << endl;
+    FixedBlockPool(size_t size, size_t perChunk = 256)
+        : blockSize(max(size, sizeof(FreeBlock))), blocksPerChunk(perChunk), freeList(nullptr), inUse(0) {
+        // 块大小对齐到 max_align_t, 保证切出的每块都满足对齐要求
+        blockSize = (blockSize + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
     }
-
-    void start() {
-        thread controlThread(&Elevator::control, this);
-        controlThread.detach();
+    
+    FixedBlockPool(const FixedBlockPool&) = delete;
+    FixedBlockPool& operator=(const FixedBlockPool&) = delete;
+    
+    void* allocate() {
+        if (!freeList) grow();
+        FreeBlock* block = freeList;
+        freeList = block->next;
+        inUse++;
+        return block;
     }
-
-    void stop() {
-        running = false;
-        cv.notify_all();
+    
+    void deallocate(void* p) {
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        block->next = freeList;
+        freeList = block;
+        inUse--;
     }
+    
+    size_t getBlockSize() const { return blockSize; }
+    size_t used() const { return inUse; }
+    size_t capacity() const { return chunks.size() * blocksPerChunk; }
+};
 
-    bool requestFloor(int floor, RequestType type = RequestType::INTERNAL, bool emergency = false) {
-        if (floor < 1 || floor > maxFloors) {
-            cout << "电梯 " << id << ": 无效楼层 " << floor << endl;
-            return false;
+// 按大小分级的节点池, 为 set/map 等节点式容器提供内存
+// 超过 MAX_BLOCK 的请求回退到全局 operator new
+class NodePool {
+private:
+    static const size_t GRANULE = 16;
+    static const size_t MAX_BLOCK = 128;
+    vector<unique_ptr<FixedBlockPool>> classes;
+    
+public:
+    NodePool() {
+        for (size_t size = GRANULE; size <= MAX_BLOCK; size += GRANULE) {
+            classes.push_back(make_unique<FixedBlockPool>(size));
         }
-
-        if (maintenanceMode && !emergency) {
-            cout << "电梯 " << id << ": 维护模式中，不接受新请求" << endl;
-            return false;
+    }
+    
+    void* allocate(size_t bytes) {
+        if (bytes == 0 || bytes > MAX_BLOCK) return ::operator new(bytes);
+        return classes[(bytes - 1) / GRANULE]->allocate();
+    }
+    
+    void deallocate(void* p, size_t bytes) {
+        if (bytes == 0 || bytes > MAX_BLOCK) {
+            ::operator delete(p);
+            return;
         }
+        classes[(bytes - 1) / GRANULE]->deallocate(p);
+    }
+};
 
-        if (emergency) {
-            emergencyStop = true;
-            cout << "电梯 " << id << ": 紧急停止请求!" << endl;
-            logEvent("紧急停止请求");
-            cv.notify_one();
-            return true;
+// 标准容器分配器, 单个对象从 NodePool 分配, 数组回退到 operator new
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+    
+    NodePool* pool;
+    
+    explicit PoolAllocator(NodePool* p) : pool(p) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+    
+    T* allocate(size_t n) {
+        if (n == 1) return static_cast<T*>(pool->allocate(sizeof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    
+    void deallocate(T* p, size_t n) {
+        if (n == 1) {
+            pool->deallocate(p, sizeof(T));
+        } else {
+            ::operator delete(p);
         }
+    }
+    
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& other) const { return pool != other.pool; }
+};
 
-        lock_guard<mutex> lock(mtx);
+// 单线程调度器: 按时间顺序执行回调, 可使用真实时钟或虚拟时钟
+// 虚拟时钟下不真正等待, 直接跳到下一个到期时间, 用于快速仿真
+// post 系列函数可从任意线程调用, 回调只在 run() 所在线程执行
+class SimScheduler {
+public:
+    enum class ClockMode {
+        REAL,
+        VIRTUAL
+    };
+    
+private:
+    struct Task {
+        chrono::steady_clock::time_point when;
+        unsigned long long seq;  // 同一时刻的任务按提交顺序执行
+        function<void()> fn;
         
-        if (type == RequestType::INTERNAL) {
-            if (internalRequests.find(floor) == internalRequests.end()) {
-                internalRequests.insert(floor);
-                cout << "电梯 " << id << ": 收到内部请求 " << floor << "楼" << endl;
-                logEvent("收到内部请求 " + to_string(floor) + "楼");
-                cv.notify_one();
-                return true;
-            }
-        } else {
-            // 外部请求
-            if (externalRequests.find(floor) == externalRequests.end()) {
-                externalRequests[floor] = make_pair(false, false);
-            }
-            
-            if (type == RequestType::EXTERNAL_UP) {
-                externalRequests[floor].first = true;
-                cout << "电梯 " << id << ": 收到外部上行请求 " << floor << "楼" << endl;
-                logEvent("收到外部上行请求 " + to_string(floor) + "楼");
-            } else {
-                externalRequests[floor].second = true;
-                cout << "电梯 " << id << ": 收到外部下行请求 " << floor << "楼" << endl;
-                logEvent("收到外部下行请求 " + to_string(floor) + "楼");
-            }
-            
-            cv.notify_one();
-            return true;
+        bool operator>(const Task& other) const {
+            return when != other.when ? when > other.when : seq > other.seq;
         }
-        return false;
+    };
+    
+    ClockMode mode;
+    chrono::steady_clock::time_point virtualNow;
+    mutable mutex mtx;
+    condition_variable cv;
+    vector<Task> tasks;  // 按 greater<Task> 组织的最小堆; 弹出时移出回调, 不复制
+    unsigned long long nextSeq;
+    bool stopping;
+    
+public:
+    SimScheduler(ClockMode clockMode = ClockMode::REAL)
+        : mode(clockMode), virtualNow(chrono::steady_clock::now()), nextSeq(0), stopping(false) {}
+    
+    chrono::steady_clock::time_point now() const {
+        if (mode == ClockMode::REAL) return chrono::steady_clock::now();
+        lock_guard<mutex> lock(mtx);
+        return virtualNow;
     }
-
-    void control() {
-        while (running) {
-            // 检查紧急停止
-            if (emergencyStop) {
-                handleEmergency();
+    
+    bool isVirtual() const { return mode == ClockMode::VIRTUAL; }
+    
+    void postAt(chrono::steady_clock::time_point when, function<void()> fn) {
+        {
+            lock_guard<mutex> lock(mtx);
+            tasks.push_back({when, nextSeq++, move(fn)});
+            push_heap(tasks.begin(), tasks.end(), greater<Task>());
+        }
+        cv.notify_one();
+    }
+    
+    void postAfter(chrono::milliseconds delay, function<void()> fn) {
+        postAt(now() + delay, move(fn));
+    }
+    
+    void post(function<void()> fn) {
+        postAt(now(), move(fn));
+    }
+    
+    // 预留 n 个任务的空间: 预先登记大量事件时, 队列不必逐次扩容
+    void reserve(size_t n) {
+        lock_guard<mutex> lock(mtx);
+        tasks.reserve(n);
+    }
+    
+    // 执行任务直到 stop(), 或虚拟时钟下没有剩余任务
+    void run() {
+        runUntil(chrono::steady_clock::time_point::max());
+    }
+    
+    // 执行到期时间不晚于 end 的任务
+    void runUntil(chrono::steady_clock::time_point end) {
+        unique_lock<mutex> lock(mtx);
+        while (!stopping) {
+            if (tasks.empty() || tasks.front().when > end) {
+                if (mode == ClockMode::VIRTUAL) {
+                    if (end != chrono::steady_clock::time_point::max()) virtualNow = max(virtualNow, end);
+                    break;
+                }
+                if (tasks.empty()) {
+                    cv.wait(lock);
+                } else {
+                    cv.wait_until(lock, min(end, tasks.front().when));
+                    if (chrono::steady_clock::now() >= end) break;
+                }
                 continue;
             }
             
-            // 检查维护模式
-            if (maintenanceMode) {
-                handleMaintenance();
+            if (mode == ClockMode::VIRTUAL) {
+                virtualNow = max(virtualNow, tasks.front().when);
+            } else if (tasks.front().when > chrono::steady_clock::now()) {
+                cv.wait_until(lock, tasks.front().when);
                 continue;
             }
-
-            unique_lock<mutex> lock(mtx);
-            cv.wait(lock, [this] { 
-                return (!internalRequests.empty() || hasExternalRequests() || !running || emergencyStop || maintenanceMode); 
-            });
-
-            if (!running) break;
-            if (emergencyStop || maintenanceMode) continue;
-
-            // 决定方向
-            if (state == ElevatorState::IDLE) {
-                if (!internalRequests.empty() || hasExternalRequests()) {
-                    int nextFloor = findNextFloor();
-                    state = (nextFloor > currentFloor) ? ElevatorState::MOVING_UP : ElevatorState::MOVING_DOWN;
-                }
-            }
-
+            
+            pop_heap(tasks.begin(), tasks.end(), greater<Task>());
+            Task task = move(tasks.back());
+            tasks.pop_back();
             lock.unlock();
-
-            // 移动电梯
-            move();
-
+            task.fn();
             lock.lock();
-            // 检查是否有请求在当前楼层
-            if (shouldStopAtCurrentFloor()) {
-                openDoors();
-                processStop();
-                closeDoors();
-            }
-
-            // 更新状态
-            updateState();
         }
     }
     
-    bool hasExternalRequests() const {
-        for (const auto& req : externalRequests) {
-            if (req.second.first || req.second.second) {
+    void stop() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+    }
+};
+
+// 工作窃取线程池: 每个工作线程有自己的任务队列, 从队尾取自己提交的任务,
+// 自己的队列空了就从其他线程的队首窃取; 运行时间差别很大的任务批次也能让各核心忙到最后
+class WorkStealingPool {
+private:
+    struct WorkerQueue {
+        mutex mtx;
+        deque<function<void()>> tasks;
+    };
+    
+    vector<unique_ptr<WorkerQueue>> queues;
+    vector<thread> workers;
+    mutex mtx;
+    condition_variable cv;       // 空闲工作线程在此等待新任务
+    condition_variable doneCv;   // wait() 在此等待全部任务完成
+    atomic<long long> queued;    // 在各队列中等待执行的任务数
+    atomic<long long> pending;   // 已提交但尚未执行完的任务数
+    atomic<long long> steals;
+    atomic<unsigned> nextQueue;
+    bool stopping;
+    
+    // 当前线程所属的线程池和队列下标, 工作线程提交的任务放入自己的队列
+    static inline thread_local WorkStealingPool* currentPool = nullptr;
+    static inline thread_local int currentIndex = -1;
+    
+    bool popLocal(int index, function<void()>& task) {
+        WorkerQueue& queue = *queues[index];
+        lock_guard<mutex> lock(queue.mtx);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+    
+    bool steal(int index, function<void()>& task) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            WorkerQueue& victim = *queues[(index + i) % queues.size()];
+            lock_guard<mutex> lock(victim.mtx);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                steals++;
                 return true;
             }
         }
         return false;
     }
     
-    int findNextFloor() {
-        // 优先处理内部请求
-        if (!internalRequests.empty()) {
-            if (state == ElevatorState::MOVING_UP) {
-                auto it = internalRequests.upper_bound(currentFloor);
-                if (it != internalRequests.end()) return *it;
-            } else if (state == ElevatorState::MOVING_DOWN) {
-                auto it = internalRequests.lower_bound(currentFloor);
-                if (it != internalRequests.begin()) return *(--it);
-            }
-            return *internalRequests.begin();
-        }
-        
-        // 处理外部请求
-        int closestFloor = -1;
-        int minDistance = maxFloors + 1;
-        
-        for (const auto& req : externalRequests) {
-            if ((req.second.first && req.first >= currentFloor) || 
-                (req.second.second && req.first <= currentFloor)) {
-                int distance = abs(req.first - currentFloor);
-                if (distance < minDistance) {
-                    minDistance = distance;
-                    closestFloor = req.first;
-                }
-            }
-        }
-        
-        if (closestFloor != -1) return closestFloor;
-        
-        // 如果没有顺路请求，找最近的请求
-        for (const auto& req : externalRequests) {
-            if (req.second.first || req.second.second) {
-                int distance = abs(req.first - currentFloor);
-                if (distance < minDistance) {
-                    minDistance = distance;
-                    closestFloor = req.first;
+    void workerLoop(int index) {
+        currentPool = this;
+        currentIndex = index;
+        while (true) {
+            function<void()> task;
+            if (popLocal(index, task) || steal(index, task)) {
+                queued--;
+                task();
+                if (--pending == 0) {
+                    lock_guard<mutex> lock(mtx);
+                    doneCv.notify_all();
                 }
+                continue;
             }
+            
+            unique_lock<mutex> lock(mtx);
+            cv.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) return;
         }
-        
-        return closestFloor;
     }
     
-    bool shouldStopAtCurrentFloor() {
-        // 检查内部请求
-        if (internalRequests.find(currentFloor) != internalRequests.end()) {
-            return true;
+public:
+    explicit WorkStealingPool(int threads)
+        : queued(0), pending(0), steals(0), nextQueue(0), stopping(false) {
+        int n = max(1, threads);
+        for (int i = 0; i < n; i++) {
+            queues.push_back(make_unique<WorkerQueue>());
         }
-        
-        // 检查外部请求
-        auto it = externalRequests.find(currentFloor);
-        if (it != externalRequests.end()) {
-            if (state == ElevatorState::MOVING_UP && it->second.first) {
-                return true;
-            }
-            if (state == ElevatorState::MOVING_DOWN && it->second.second) {
-                return true;
-            }
-            if (state == ElevatorState::IDLE && (it->second.first || it->second.second)) {
-                return true;
-            }
+        for (int i = 0; i < n; i++) {
+            workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
         }
-        
-        return false;
     }
     
-    void processStop() {
-        // 移除内部请求
-        internalRequests.erase(currentFloor);
-        
-        // 移除外部请求
-        auto it = externalRequests.find(currentFloor);
-        if (it != externalRequests.end()) {
-            if (state == ElevatorState::MOVING_UP) {
-                it->second.first = false;
-            } else if (state == ElevatorState::MOVING_DOWN) {
-                it->second.second = false;
-            } else {
-                it->second.first = false;
-                it->second.second = false;
-            }
-            
-            // 如果没有请求了，移除该楼层
-            if (!it->second.first && !it->second.second) {
-                externalRequests.erase(it);
-            }
+    ~WorkStealingPool() {
+        shutdown();
+    }
+    
+    void submit(function<void()> task) {
+        pending++;
+        int index = (currentPool == this) ? currentIndex : nextQueue++ % queues.size();
+        {
+            lock_guard<mutex> lock(queues[index]->mtx);
+            queues[index]->tasks.push_back(std::move(task));
         }
-        
+        {
+            lock_guard<mutex> lock(mtx);
+            queued++;
+        }
+        cv.notify_one();
+    }
+    
+    // 等待已提交的任务(包括执行期间新提交的任务)全部完成
+    void wait() {
+        unique_lock<mutex> lock(mtx);
+        doneCv.wait(lock, [this] { return pending == 0; });
+    }
+    
+    // 执行完剩余任务后结束工作线程
+    void shutdown() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+        workers.clear();
+    }
+    
+    int getThreadCount() const {
+        return queues.size();
+    }
+    
+    long long getStealCount() const {
+        return steals;
+    }
+};
+
+// 有界无锁多生产者队列(Vyukov 算法), 消费者只能有一个, 由使用者保证
+// 每个槽位的序号表明它当前可写还是可读, 生产者用 CAS 抢占写入位置
+template <typename T, size_t Capacity>
+class BoundedMpscQueue {
+private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "容量必须是2的幂");
+    
+    struct Cell {
+        atomic<size_t> sequence;
+        T data;
+    };
+    
+    Cell cells[Capacity];
+    alignas(64) atomic<size_t> tail;  // 生产者的下一个写入位置
+    alignas(64) size_t head;          // 消费者的下一个读取位置
+    
+public:
+    BoundedMpscQueue() : tail(0), head(0) {
+        for (size_t i = 0; i < Capacity; i++) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+    
+    // 队列已满时返回 false, 不阻塞
+    bool push(const T& value) {
+        size_t pos = tail.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & (Capacity - 1)];
+            size_t seq = cell.sequence.load(memory_order_acquire);
+            long long diff = (long long)seq - (long long)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    cell.data = value;
+                    cell.sequence.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+    }
+    
+    bool pop(T& value) {
+        Cell& cell = cells[head & (Capacity - 1)];
+        size_t seq = cell.sequence.load(memory_order_acquire);
+        if ((long long)seq - (long long)(head + 1) < 0) {
+            return false;
+        }
+        value = cell.data;
+        cell.sequence.store(head + Capacity, memory_order_release);
+        head++;
+        return true;
+    }
+    
+    // 只能由消费者调用
+    bool empty() const {
+        const Cell& cell = cells[head & (Capacity - 1)];
+        return (long long)cell.sequence.load(memory_order_acquire) - (long long)(head + 1) < 0;
+    }
+};
+
+// 电梯收件箱中的请求
+struct InboxEntry {
+    int floor;
+    RequestType type;
+};
+
+// 电梯请求集合使用节点池分配, 避免每次请求都申请树节点
+using FloorSet = set<int, less<int>, PoolAllocator<int>>;
+using HallCallMap = map<int, pair<bool, bool>, less<int>, PoolAllocator<pair<const int, pair<bool, bool>>>>;
+
+class Elevator;
+
+// 井道: 同一井道内可运行多部轿厢(如双子电梯), 轿厢自下而上编号(slot 0 最低)
+// 每部轿厢占用一个楼层区间, 停靠时是一层, 移动中同时占用出发层和目标层;
+// 相邻轿厢的占用区间不能重叠, 移动前必须先通过 tryMove() 占用下一层;
+// 请对方让行后, 到达让行目标前对方不得再驶回这段路径, 否则迎面相遇的两部轿厢会反复互让
+class Shaft {
+private:
+    static constexpr int NO_CLAIM = INT_MIN;
+    
+    struct Slot {
+        Elevator* car;
+        int low;    // 占用的最低楼层
+        int high;   // 占用的最高楼层
+        int claim;  // 已请相邻轿厢让出、尚未到达的目标楼层
+        ElevatorState state;  // 轿厢最近报告的状态; 其他轿厢只读这里, 不读 Elevator 本身
+    };
+    
+    mutex mtx;
+    vector<Slot> slots;
+    
+    // 返回挡住 slot 移动到 to 的相邻轿厢, 没有则返回 -1
+    int findBlocker(int slot, int to) const {
+        if (to > slots[slot].high && slot + 1 < (int)slots.size() && slots[slot + 1].low <= to) return slot + 1;
+        if (to < slots[slot].low && slot > 0 && slots[slot - 1].high >= to) return slot - 1;
+        return -1;
+    }
+    
+    // 向相邻轿厢方向移动时, to 是否在对方要求让出的路径上
+    bool claimedByNeighbour(int slot, int to) const {
+        if (to > slots[slot].high && slot + 1 < (int)slots.size()) {
+            return slots[slot + 1].claim != NO_CLAIM && slots[slot + 1].claim <= to;
+        }
+        if (to < slots[slot].low && slot > 0) {
+            return slots[slot - 1].claim != NO_CLAIM && slots[slot - 1].claim >= to;
+        }
+        return false;
+    }
+    
+public:
+    // 在井道顶部加入一部轿厢, 返回其编号
+    int attach(Elevator* car, int floor) {
+        lock_guard<mutex> lock(mtx);
+        slots.push_back({car, floor, floor, NO_CLAIM, ElevatorState::IDLE});
+        return slots.size() - 1;
+    }
+    
+    // 申请移动到相邻楼层 to, 成功时占用 to 直到 arrived()
+    bool tryMove(int slot, int to) {
+        lock_guard<mutex> lock(mtx);
+        if (findBlocker(slot, to) >= 0 || claimedByNeighbour(slot, to)) return false;
+        slots[slot].low = min(slots[slot].low, to);
+        slots[slot].high = max(slots[slot].high, to);
+        return true;
+    }
+    
+    void arrived(int slot, int floor) {
+        lock_guard<mutex> lock(mtx);
+        slots[slot].low = slots[slot].high = floor;
+        if (slots[slot].claim == floor) slots[slot].claim = NO_CLAIM;
+    }
+    
+    // 轿厢状态变化时调用
+    void report(int slot, ElevatorState state) {
+        lock_guard<mutex> lock(mtx);
+        slots[slot].state = state;
+    }
+    
+    // 不再需要相邻轿厢让行(空闲、紧急停止或自己被要求让行)
+    void releaseClaim(int slot) {
+        lock_guard<mutex> lock(mtx);
+        slots[slot].claim = NO_CLAIM;
+    }
+    
+    // 到 floor 的路径上是否隔着其他轿厢
+    bool pathBlocked(int slot, int floor) {
+        lock_guard<mutex> lock(mtx);
+        if (floor > slots[slot].high) {
+            return slot + 1 < (int)slots.size() && slots[slot + 1].low <= floor;
+        }
+        if (floor < slots[slot].low) {
+            return slot > 0 && slots[slot - 1].high >= floor;
+        }
+        return false;
+    }
+    
+    // 请挡路的轿厢为 slot 让出到 target 的路径, 定义在 Elevator 之后
+    void requestClearance(int slot, int to, int target);
+};
+
+// 线程调度配置: 电梯控制线程绑定到指定 CPU, 可使用实时调度策略;
+// 监控、日志、统计等辅助线程放到另一组 CPU, 以普通优先级运行, 不与控制线程争抢
+struct ThreadTuning {
+    enum class Policy {
+        NORMAL,  // 不修改调度策略
+        FIFO,    // SCHED_FIFO
+        RR       // SCHED_RR
+    };
+    
+    vector<int> controlCpus;    // 控制线程可用的 CPU, 为空表示不绑定
+    vector<int> auxiliaryCpus;  // 辅助线程可用的 CPU, 为空表示不绑定
+    Policy policy = Policy::NORMAL;
+    int priority = 0;           // 实时调度优先级, 仅 FIFO/RR 有效
+    
+    bool empty() const {
+        return controlCpus.empty() && auxiliaryCpus.empty() && policy == Policy::NORMAL;
+    }
+    
+    // 由控制线程在启动时调用
+    void applyControl() const {
+        apply(controlCpus, policy, priority);
+    }
+    
+    // 由辅助线程在启动时调用
+    void applyAuxiliary() const {
+        apply(auxiliaryCpus, Policy::NORMAL, 0);
+    }
+    
+    // 解析 "0,2-3" 形式的 CPU 列表, 格式错误返回 false
+    static bool parseCpuList(const string& text, vector<int>& cpus) {
+        cpus.clear();
+        stringstream ss(text);
+        string item;
+        while (getline(ss, item, ',')) {
+            size_t dash = item.find('-');
+            try {
+                int first = stoi(item.substr(0, dash));
+                int last = dash == string::npos ? first : stoi(item.substr(dash + 1));
+                if (first < 0 || last < first) return false;
+                for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+            } catch (exception&) {
+                return false;
+            }
+        }
+        return !cpus.empty();
+    }
+    
+private:
+    // 设置失败(如没有 CAP_SYS_NICE 权限)只提示一次, 线程照常以默认方式运行
+    static void warnOnce(const string& message) {
+        static atomic<bool> warned{false};
+        if (!warned.exchange(true)) {
+            ELEVATOR_LOG_WARN("线程调度设置失败: " << message << ", 以默认方式运行");
+        }
+    }
+    
+    static void apply(const vector<int>& cpus, Policy policy, int priority) {
+#ifdef __linux__
+        if (!cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus) {
+                if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+            }
+            int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            if (err != 0) warnOnce(string("绑定 CPU: ") + strerror(err));
+        }
+        if (policy != Policy::NORMAL) {
+            int native = policy == Policy::FIFO ? SCHED_FIFO : SCHED_RR;
+            sched_param param{};
+            param.sched_priority = max(sched_get_priority_min(native), min(priority, sched_get_priority_max(native)));
+            int err = pthread_setschedparam(pthread_self(), native, &param);
+            if (err != 0) warnOnce(string("实时调度: ") + strerror(err));
+        }
+#else
+        if (!cpus.empty() || policy != Policy::NORMAL) {
+            warnOnce("当前平台不支持");
+        }
+#endif
+    }
+};
+
+// 时间服务: 事件使用单调时钟的纳秒时间戳, 只在输出时换算成墙上时间;
+// 格式化结果按线程缓存到秒, 同一秒内的输出不再做时区转换, 也不使用非线程安全的 localtime
+class ClockService {
+private:
+    long long wallOffset;  // system_clock - steady_clock, 启动时测定
+    
+    ClockService() {
+        auto wall = chrono::system_clock::now().time_since_epoch();
+        auto mono = chrono::steady_clock::now().time_since_epoch();
+        wallOffset = chrono::duration_cast<chrono::nanoseconds>(wall).count()
+                   - chrono::duration_cast<chrono::nanoseconds>(mono).count();
+    }
+    
+public:
+    static ClockService& instance() {
+        static ClockService clock;
+        return clock;
+    }
+    
+    static long long monotonicNanos() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    long long getWallOffset() const {
+        return wallOffset;
+    }
+    
+    long long toWallNanos(long long monotonic) const {
+        return monotonic + wallOffset;
+    }
+    
+    // 格式化为 "%Y-%m-%d %H:%M:%S"; 返回的指针在本线程下次调用前有效
+    static const char* format(time_t seconds) {
+        struct Cache {
+            time_t seconds = -1;
+            char text[32] = "";
+        };
+        static thread_local Cache cache;
+        if (seconds != cache.seconds) {
+            tm local;
+            localtime_r(&seconds, &local);
+            strftime(cache.text, sizeof(cache.text), "%Y-%m-%d %H:%M:%S", &local);
+            cache.seconds = seconds;
+        }
+        return cache.text;
+    }
+    
+    static const char* formatNow() {
+        return format(time(nullptr));
+    }
+};
+
+// 事件代码: 日志中每条记录对应一种事件, 参数含义见 EventRenderer
+enum class EventCode : uint16_t {
+    LOG_START,              // a: 容量, b: 最低楼层, c: 最高楼层
+    EMERGENCY_REQUEST,
+    INTERNAL_REQUEST,       // a: 楼层
+    HALL_REQUEST,           // a: 楼层, b: 1 上行 / 2 下行
+    HEARTBEAT_RECOVERED,
+    ARRIVED,                // a: 楼层
+    DOORS_OPENED,           // a: 楼层
+    OVERLOAD,
+    DOORS_CLOSED,
+    PASSENGERS,             // a: 进入人数, b: 离开人数, c: 当前乘客
+    EMERGENCY_ACTIVATED,
+    EMERGENCY_DOORS_OPENED, // a: 楼层
+    EMERGENCY_CLEARED,
+    MAINTENANCE_ENDED,
+    SHAFT_YIELD,            // a: 让行后所在楼层
+    INTERNAL_CANCELLED,     // a: 楼层
+    HALL_CANCELLED,         // a: 楼层, b: 1 上行 / 2 下行
+    CAR_STALLED,            // 系统日志, car: 停滞的电梯
+    BUILDING_EMERGENCY,     // 系统日志, a: 触发楼层, b: 电梯数
+    BUILDING_EMERGENCY_CLEARED,
+    CLOCK_SYNC,             // a/b: 墙上时间偏移的高/低 32 位, 打开日志时写入
+    DEPARTED,               // a: 出发楼层, b: 1 上行 / 2 下行
+    DOORS_SHUT,             // 关门完成
+    DISPATCHED,             // 系统日志, car: 分配到的电梯, a: 楼层, b: 0 内部 / 1 上行 / 2 下行
+    COUNT
+};
+
+// 二进制日志记录, 固定 24 字节; 文件以 EVENT_LOG_MAGIC 开头, 之后是连续的记录
+struct EventRecord {
+    int64_t timestampNanos;  // steady_clock 时间, 加上此前最近一条 CLOCK_SYNC 中的偏移即为墙上时间
+    uint16_t car;            // 电梯编号, 0 表示控制系统
+    uint16_t code;           // EventCode
+    int32_t a;
+    int32_t b;
+    int32_t c;
+};
+static_assert(sizeof(EventRecord) == 24, "EventRecord 布局必须固定");
+
+inline EventRecord makeClockSync(long long monotonic, long long wallOffset) {
+    return {monotonic, 0, (uint16_t)EventCode::CLOCK_SYNC, (int32_t)(wallOffset >> 32), (int32_t)(uint32_t)wallOffset, 0};
+}
+
+inline long long clockSyncOffset(const EventRecord& record) {
+    return ((long long)record.a << 32) | (uint32_t)record.b;
+}
+
+static const char EVENT_LOG_MAGIC[8] = {'E', 'L', 'V', 'E', 'V', 'T', '0', '2'};
+
+// 把二进制记录还原成与控制台一致的中文描述; 乘客人数需要 LOG_START 中记录的容量
+class EventRenderer {
+private:
+    unordered_map<int, int> capacities;
+    
+public:
+    string describe(const EventRecord& record) {
+        char text[160];
+        const char* direction = record.b == 1 ? "上行" : "下行";
+        switch ((EventCode)record.code) {
+            case EventCode::LOG_START:
+                capacities[record.car] = record.a;
+                snprintf(text, sizeof(text), "日志开始 (容量 %d, %d-%d楼)", record.a, record.b, record.c);
+                break;
+            case EventCode::EMERGENCY_REQUEST: snprintf(text, sizeof(text), "紧急停止请求"); break;
+            case EventCode::INTERNAL_REQUEST: snprintf(text, sizeof(text), "收到内部请求 %d楼", record.a); break;
+            case EventCode::HALL_REQUEST: snprintf(text, sizeof(text), "收到外部%s请求 %d楼", direction, record.a); break;
+            case EventCode::HEARTBEAT_RECOVERED: snprintf(text, sizeof(text), "控制循环恢复响应"); break;
+            case EventCode::ARRIVED: snprintf(text, sizeof(text), "到达 %d楼", record.a); break;
+            case EventCode::DOORS_OPENED: snprintf(text, sizeof(text), "门在 %d 楼打开", record.a); break;
+            case EventCode::OVERLOAD: snprintf(text, sizeof(text), "超载警告"); break;
+            case EventCode::DOORS_CLOSED: snprintf(text, sizeof(text), "门关闭"); break;
+            case EventCode::PASSENGERS: {
+                auto it = capacities.find(record.car);
+                if (it != capacities.end()) {
+                    snprintf(text, sizeof(text), "%d人进入, %d人离开, 当前乘客: %d/%d", record.a, record.b, record.c, it->second);
+                } else {
+                    snprintf(text, sizeof(text), "%d人进入, %d人离开, 当前乘客: %d", record.a, record.b, record.c);
+                }
+                break;
+            }
+            case EventCode::EMERGENCY_ACTIVATED: snprintf(text, sizeof(text), "紧急停止已激活"); break;
+            case EventCode::EMERGENCY_DOORS_OPENED: snprintf(text, sizeof(text), "紧急开门在 %d 楼", record.a); break;
+            case EventCode::EMERGENCY_CLEARED: snprintf(text, sizeof(text), "紧急情况解除，恢复正常运行"); break;
+            case EventCode::MAINTENANCE_ENDED: snprintf(text, sizeof(text), "维护模式结束，恢复正常运行"); break;
+            case EventCode::SHAFT_YIELD: snprintf(text, sizeof(text), "井道让行, 移至 %d楼", record.a); break;
+            case EventCode::INTERNAL_CANCELLED: snprintf(text, sizeof(text), "取消内部请求 %d楼", record.a); break;
+            case EventCode::HALL_CANCELLED: snprintf(text, sizeof(text), "取消外部%s请求 %d楼", direction, record.a); break;
+            case EventCode::CAR_STALLED: snprintf(text, sizeof(text), "控制循环停滞, 暂停派梯"); break;
+            case EventCode::BUILDING_EMERGENCY:
+                snprintf(text, sizeof(text), "全楼紧急停止, 触发楼层 %d, 电梯数 %d", record.a, record.b);
+                break;
+            case EventCode::BUILDING_EMERGENCY_CLEARED: snprintf(text, sizeof(text), "全楼紧急状态解除"); break;
+            case EventCode::CLOCK_SYNC: snprintf(text, sizeof(text), "时钟同步"); break;
+            case EventCode::DEPARTED: snprintf(text, sizeof(text), "从 %d楼%s出发", record.a, direction); break;
+            case EventCode::DOORS_SHUT: snprintf(text, sizeof(text), "关门完成"); break;
+            case EventCode::DISPATCHED:
+                snprintf(text, sizeof(text), "分配请求 %d楼%s", record.a, record.b == 0 ? "" : direction);
+                break;
+            default:
+                snprintf(text, sizeof(text), "未知事件 %d (%d, %d, %d)", record.code, record.a, record.b, record.c);
+                break;
+        }
+        return text;
+    }
+    
+    // 文本格式: [时间] 电梯 N: 描述; wallOffset 取自最近的 CLOCK_SYNC
+    string renderText(const EventRecord& record, long long wallOffset) {
+        time_t seconds = (record.timestampNanos + wallOffset) / 1000000000LL;
+        string line = string("[") + ClockService::format(seconds) + "] ";
+        if (record.car > 0) line += "电梯 " + to_string(record.car) + ": ";
+        return line + describe(record);
+    }
+    
+    // CSV 格式: timestamp_ns,car,code,a,b,c,text, 时间为墙上时间
+    string renderCsv(const EventRecord& record, long long wallOffset) {
+        string text = describe(record);
+        string line = to_string(record.timestampNanos + wallOffset) + "," + to_string(record.car) + "," + to_string(record.code) + ","
+                    + to_string(record.a) + "," + to_string(record.b) + "," + to_string(record.c) + ",\"";
+        for (char ch : text) {
+            if (ch == '"') line += '"';
+            line += ch;
+        }
+        return line + "\"";
+    }
+};
+
+// 日志轮转设置: 当前段超过 maxBytes 或持续超过 maxAge 即轮转, 0 表示不按该条件轮转;
+// 轮转出的段命名为 <日志文件>.<年月日-时分秒>, 每个日志文件最多保留 retain 段
+struct LogRotation {
+    long long maxBytes = 64LL * 1024 * 1024;
+    chrono::seconds maxAge = chrono::hours(24);
+    int retain = 14;
+    bool compress = true;
+};
+
+// 日志归档线程: 压缩轮转出的日志段并删除超出保留数量的旧段,
+// 压缩耗时较长, 放在单独的线程中, 不影响日志写线程和控制线程
+class LogArchiver {
+private:
+    struct Job {
+        string segment;   // 轮转出的日志段
+        string basePath;  // 所属日志文件, 用于查找同一文件的其他段
+        int retain;
+        bool compress;
+    };
+    
+    static constexpr size_t CHUNK_BYTES = 64 * 1024;  // 流式压缩每次读取的大小
+    
+    mutex mtx;
+    condition_variable cv;
+    deque<Job> jobs;
+    bool stopping;
+    bool retune;
+    ThreadTuning tuning;
+    thread worker;
+    
+    // 压缩成 <segment>.gz 后删除原文件, 失败时保留未压缩的段
+    static bool compressFile(const string& segment) {
+#ifdef ELEVATOR_HAVE_ZLIB
+        FILE* in = fopen(segment.c_str(), "rb");
+        if (!in) return false;
+        string temp = segment + ".gz.tmp";
+        gzFile out = gzopen(temp.c_str(), "wb6");
+        if (!out) {
+            fclose(in);
+            return false;
+        }
+        vector<char> chunk(CHUNK_BYTES);
+        size_t count;
+        bool ok = true;
+        while (ok && (count = fread(chunk.data(), 1, chunk.size(), in)) > 0) {
+            ok = gzwrite(out, chunk.data(), (unsigned)count) == (int)count;
+        }
+        fclose(in);
+        ok = gzclose(out) == Z_OK && ok;
+        if (!ok || rename(temp.c_str(), (segment + ".gz").c_str()) != 0) {
+            remove(temp.c_str());
+            return false;
+        }
+        return remove(segment.c_str()) == 0;
+#else
+        const char* argv[] = {"gzip", "-f", "--", segment.c_str(), nullptr};
+        pid_t pid;
+        if (posix_spawnp(&pid, "gzip", nullptr, nullptr, const_cast<char* const*>(argv), environ) != 0) return false;
+        int status;
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) return false;
+        }
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+    }
+    
+    // 同一日志文件的段按名称(即轮转时间)排序, 删除最旧的段直到只剩 retain 段
+    static void enforceRetention(const string& basePath, int retain) {
+        filesystem::path base(basePath);
+        string prefix = base.filename().string() + ".";
+        vector<pair<string, filesystem::path>> segments;
+        error_code ec;
+        for (const auto& entry : filesystem::directory_iterator(base.parent_path().empty() ? "." : base.parent_path(), ec)) {
+            string name = entry.path().filename().string();
+            if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) continue;
+            if (name.size() > 7 && name.compare(name.size() - 7, 7, ".gz.tmp") == 0) continue;
+            string key = name;
+            if (key.size() > 3 && key.compare(key.size() - 3, 3, ".gz") == 0) key.resize(key.size() - 3);
+            segments.push_back({key, entry.path()});
+        }
+        sort(segments.begin(), segments.end());
+        for (size_t i = 0; i + retain < segments.size(); i++) {
+            filesystem::remove(segments[i].second, ec);
+        }
+    }
+    
+    void workerLoop() {
+        unique_lock<mutex> lock(mtx);
+        while (true) {
+            cv.wait(lock, [this] { return stopping || retune || !jobs.empty(); });
+            if (retune) {
+                retune = false;
+                tuning.applyAuxiliary();
+            }
+            if (jobs.empty()) {
+                if (stopping) break;
+                continue;
+            }
+            Job job = jobs.front();
+            jobs.pop_front();
+            lock.unlock();
+            if (job.compress) compressFile(job.segment);
+            enforceRetention(job.basePath, job.retain);
+            lock.lock();
+        }
+    }
+    
+public:
+    LogArchiver() : stopping(false), retune(false) {
+        worker = thread(&LogArchiver::workerLoop, this);
+    }
+    
+    // 处理完已提交的段后退出
+    ~LogArchiver() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+    
+    void submit(const string& segment, const string& basePath, const LogRotation& rotation) {
+        {
+            lock_guard<mutex> lock(mtx);
+            jobs.push_back({segment, basePath, max(0, rotation.retain), rotation.compress});
+        }
+        cv.notify_one();
+    }
+    
+    void setThreadTuning(const ThreadTuning& threadTuning) {
+        {
+            lock_guard<mutex> lock(mtx);
+            tuning = threadTuning;
+            retune = true;
+        }
+        cv.notify_one();
+    }
+};
+
+// 单行 JSON 输出: 在定长缓冲区中拼接, 不分配内存, 缓冲区满时先写出一部分;
+// 析构时补上换行写出; 整行只在写出时锁住 FILE, 较短的行不会与其他线程的输出交错
+class JsonLineWriter {
+private:
+    FILE* out;
+    char buffer[1024];
+    size_t used;
+    bool needComma;  // 下一个值之前需要逗号
+    
+    void flushBuffer() {
+        fwrite(buffer, 1, used, out);
+        used = 0;
+    }
+    
+    void put(const char* data, size_t size) {
+        if (used + size > sizeof(buffer)) {
+            flushBuffer();
+            if (size > sizeof(buffer)) {
+                fwrite(data, 1, size, out);
+                return;
+            }
+        }
+        memcpy(buffer + used, data, size);
+        used += size;
+    }
+    
+    void put(char ch) {
+        if (used == sizeof(buffer)) flushBuffer();
+        buffer[used++] = ch;
+    }
+    
+    void putString(const char* text) {
+        put('"');
+        for (const char* p = text; *p; p++) {
+            unsigned char ch = *p;
+            if (ch == '"' || ch == '\\') {
+                put('\\');
+                put((char)ch);
+            } else if (ch < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+                put(escaped, 6);
+            } else {
+                put((char)ch);
+            }
+        }
+        put('"');
+    }
+    
+    void putNumber(long long value) {
+        char digits[24];
+        auto result = to_chars(digits, digits + sizeof(digits), value);
+        put(digits, result.ptr - digits);
+    }
+    
+    void beginValue() {
+        if (needComma) put(',');
+        needComma = true;
+    }
+    
+    void key(const char* name) {
+        beginValue();
+        putString(name);
+        put(':');
+    }
+    
+public:
+    explicit JsonLineWriter(FILE* out) : out(out), used(0), needComma(false) {
+        put('{');
+    }
+    
+    ~JsonLineWriter() {
+        put('}');
+        put('\n');
+        flushBuffer();
+    }
+    
+    JsonLineWriter(const JsonLineWriter&) = delete;
+    JsonLineWriter& operator=(const JsonLineWriter&) = delete;
+    
+    void field(const char* name, long long value) {
+        key(name);
+        putNumber(value);
+    }
+    
+    void field(const char* name, int value) {
+        field(name, (long long)value);
+    }
+    
+    void field(const char* name, double value) {
+        key(name);
+        char digits[32];
+        put(digits, snprintf(digits, sizeof(digits), "%.3f", value));
+    }
+    
+    void field(const char* name, bool value) {
+        key(name);
+        if (value) put("true", 4);
+        else put("false", 5);
+    }
+    
+    void field(const char* name, const char* value) {
+        key(name);
+        putString(value);
+    }
+    
+    void beginArray(const char* name) {
+        key(name);
+        put('[');
+        needComma = false;
+    }
+    
+    void endArray() {
+        put(']');
+        needComma = true;
+    }
+    
+    // 数组中的对象
+    void beginObject() {
+        beginValue();
+        put('{');
+        needComma = false;
+    }
+    
+    void endObject() {
+        put('}');
+        needComma = true;
+    }
+    
+    // 数组中的数字
+    void element(long long value) {
+        beginValue();
+        putNumber(value);
+    }
+};
+
+// 各事件在 JSON 中的名称和参数名, 按 EventCode 的顺序; 参数名为空表示没有该参数
+struct EventSchema {
+    const char* name;
+    const char* a;
+    const char* b;
+    const char* c;
+};
+
+static const EventSchema EVENT_SCHEMAS[] = {
+    {"log_start", "capacity", "min_floor", "max_floor"},
+    {"emergency_request", nullptr, nullptr, nullptr},
+    {"internal_request", "floor", nullptr, nullptr},
+    {"hall_request", "floor", "direction", nullptr},
+    {"heartbeat_recovered", nullptr, nullptr, nullptr},
+    {"arrived", "floor", nullptr, nullptr},
+    {"doors_opened", "floor", nullptr, nullptr},
+    {"overload", nullptr, nullptr, nullptr},
+    {"doors_closed", nullptr, nullptr, nullptr},
+    {"passengers", "entering", "exiting", "passengers"},
+    {"emergency_activated", nullptr, nullptr, nullptr},
+    {"emergency_doors_opened", "floor", nullptr, nullptr},
+    {"emergency_cleared", nullptr, nullptr, nullptr},
+    {"maintenance_ended", nullptr, nullptr, nullptr},
+    {"shaft_yield", "floor", nullptr, nullptr},
+    {"internal_cancelled", "floor", nullptr, nullptr},
+    {"hall_cancelled", "floor", "direction", nullptr},
+    {"car_stalled", nullptr, nullptr, nullptr},
+    {"building_emergency", "floor", "cars", nullptr},
+    {"building_emergency_cleared", nullptr, nullptr, nullptr},
+    {"clock_sync", nullptr, nullptr, nullptr},
+    {"departed", "floor", "direction", nullptr},
+    {"doors_shut", nullptr, nullptr, nullptr},
+    {"dispatched", "floor", "direction", nullptr},
+};
+static_assert(sizeof(EVENT_SCHEMAS) / sizeof(EVENT_SCHEMAS[0]) == (size_t)EventCode::COUNT, "每种事件都需要 JSON 名称");
+
+// 一条事件输出为一行 JSON: {"type":"event","ts":墙上时间纳秒,"car":N,"event":名称,参数...}
+// direction 参数输出为 "car"(内部)、"up" 或 "down"
+inline void writeEventJson(FILE* out, const EventRecord& record, long long wallOffset) {
+    JsonLineWriter json(out);
+    json.field("type", "event");
+    json.field("ts", (long long)(record.timestampNanos + wallOffset));
+    json.field("car", (int)record.car);
+    if (record.code >= (uint16_t)EventCode::COUNT) {
+        json.field("event", "unknown");
+        json.field("code", (int)record.code);
+        json.field("a", record.a);
+        json.field("b", record.b);
+        json.field("c", record.c);
+        return;
+    }
+    const EventSchema& schema = EVENT_SCHEMAS[record.code];
+    json.field("event", schema.name);
+    const char* names[] = {schema.a, schema.b, schema.c};
+    int values[] = {record.a, record.b, record.c};
+    for (int i = 0; i < 3; i++) {
+        if (!names[i]) continue;
+        if (strcmp(names[i], "direction") == 0) {
+            json.field(names[i], values[i] == 1 ? "up" : values[i] == 2 ? "down" : "car");
+        } else {
+            json.field(names[i], values[i]);
+        }
+    }
+}
+
+// JSON 行模式下把刚发生的事件写到标准输出
+inline void emitEventJson(int car, EventCode code, int a, int b, int c) {
+    EventRecord record{ClockService::monotonicNanos(), (uint16_t)car, (uint16_t)code, a, b, c};
+    writeEventJson(stdout, record, ClockService::instance().getWallOffset());
+}
+
+// 解码工具的输出格式
+enum class EventFormat {
+    TEXT,
+    CSV,
+    JSON
+};
+
+inline EventFormat parseEventFormat(int argc, char* argv[], int index) {
+    if (argc <= index) return EventFormat::TEXT;
+    string option = argv[index];
+    if (option == "--csv") return EventFormat::CSV;
+    if (option == "--json") return EventFormat::JSON;
+    return EventFormat::TEXT;
+}
+
+inline void printEventHeader(EventFormat format) {
+    if (format == EventFormat::CSV) cout << "timestamp_ns,car,code,a,b,c,text\n";
+}
+
+inline void printEvent(EventRenderer& renderer, const EventRecord& record, long long wallOffset, EventFormat format) {
+    switch (format) {
+        case EventFormat::TEXT: cout << renderer.renderText(record, wallOffset) << '\n'; break;
+        case EventFormat::CSV: cout << renderer.renderCsv(record, wallOffset) << '\n'; break;
+        case EventFormat::JSON:
+            if (record.code == (uint16_t)EventCode::LOG_START) renderer.describe(record);
+            cout.flush();
+            writeEventJson(stdout, record, wallOffset);
+            break;
+    }
+}
+
+// 异步日志: 各线程把日志记录放入自己的无锁环形缓冲区即返回, 后台写线程批量取出,
+// 写入长期打开的日志文件(sink), 缓冲积累到一定大小或距上次刷新超过一定时间才刷新
+class AsyncLogger {
+private:
+    struct Record {
+        int sink;
+        EventRecord event;
+    };
+    
+    // 单生产者单消费者环形缓冲区: 所属线程写入, 写线程读出
+    struct ThreadBuffer {
+        static constexpr size_t CAPACITY = 1024;
+        Record records[CAPACITY];
+        atomic<size_t> head{0};  // 写线程读取的位置
+        atomic<size_t> tail{0};  // 所属线程写入的位置
+        atomic<bool> orphaned{false};  // 所属线程已退出, 读空后可回收
+    };
+    
+    // 线程退出时把缓冲区交还给写线程回收
+    struct BufferHolder {
+        shared_ptr<ThreadBuffer> buffer;
+        ~BufferHolder() {
+            if (buffer) buffer->orphaned = true;
+        }
+    };
+    
+    struct Sink {
+        string path;
+        FILE* file;
+        string pending;     // 尚未写出的内容
+        string preamble;    // 最近一条 LOG_START, 轮转后写在新段开头, 使每段都能单独解码
+        long long bytes;    // 当前段已写入的字节数
+        long long openedAt; // 当前段的开始时间(单调时钟纳秒)
+        bool hasEvents;     // 当前段是否已写入文件头以外的记录
+        bool opened;        // 文件在第一次有内容写出时才由写线程打开
+        bool truncate;      // 打开时清空已有内容
+        int users;          // 持有此 sink 的对象数, 减到 0 后写线程写完剩余内容即关闭; path 为空表示编号空闲
+    };
+    
+    static constexpr size_t FLUSH_BYTES = 64 * 1024;                    // 单个 sink 积累到此大小即写出
+    static constexpr chrono::milliseconds FLUSH_INTERVAL{100};          // 最长刷新间隔
+    
+    mutex mtx;                                // 保护 buffers、sinks 和下面的状态
+    condition_variable cv;                    // 唤醒写线程
+    condition_variable flushedCv;             // 等待 flush() 完成
+    condition_variable spaceCv;               // 缓冲区已满的线程等待写线程取走记录
+    vector<shared_ptr<ThreadBuffer>> buffers;
+    deque<Sink> sinks;
+    unordered_map<string, int> sinkIds;
+    vector<int> freeSinkIds;
+    unsigned long long flushRequested;
+    unsigned long long flushCompleted;
+    bool stopping;
+    bool retune;
+    atomic<bool> drainRequested;              // 有缓冲区过半或已满, 写线程应立即取出
+    ThreadTuning tuning;
+    LogRotation rotation;
+    LogArchiver archiver;
+    thread writer;
+    
+    ThreadBuffer& localBuffer() {
+        static thread_local BufferHolder holder;
+        if (!holder.buffer) {
+            holder.buffer = make_shared<ThreadBuffer>();
+            lock_guard<mutex> lock(mtx);
+            buffers.push_back(holder.buffer);
+        }
+        return *holder.buffer;
+    }
+    
+    // 取出全部缓冲区中的记录, 追加到各 sink 的待写内容; 持有 mtx
+    void drainLocked() {
+        for (size_t i = 0; i < buffers.size(); i++) {
+            ThreadBuffer& buffer = *buffers[i];
+            size_t head = buffer.head.load(memory_order_relaxed);
+            size_t tail = buffer.tail.load(memory_order_acquire);
+            for (; head != tail; head++) {
+                const Record& record = buffer.records[head % ThreadBuffer::CAPACITY];
+                Sink& sink = sinks[record.sink];
+                sink.pending.append(reinterpret_cast<const char*>(&record.event), sizeof(EventRecord));
+                if (record.event.code == (uint16_t)EventCode::LOG_START) {
+                    sink.preamble.assign(reinterpret_cast<const char*>(&record.event), sizeof(EventRecord));
+                }
+                if (sink.pending.size() >= FLUSH_BYTES) writeOut(sink, false);
+            }
+            buffer.head.store(head, memory_order_release);
+        }
+        spaceCv.notify_all();
+        
+        // 回收已退出线程的空缓冲区
+        buffers.erase(remove_if(buffers.begin(), buffers.end(), [](const shared_ptr<ThreadBuffer>& b) {
+            return b->orphaned && b->head == b->tail;
+        }), buffers.end());
+    }
+    
+    // 写出待写内容, 当前段达到轮转条件时轮转; 持有 mtx
+    void writeOut(Sink& sink, bool flush) {
+        if (!sink.opened && !sink.pending.empty()) {
+            sink.file = fopen(sink.path.c_str(), sink.truncate ? "wb" : "ab");
+            sink.opened = true;
+            startSegment(sink);
+        }
+        if (sink.file && !sink.pending.empty()) {
+            sink.bytes += fwrite(sink.pending.data(), 1, sink.pending.size(), sink.file);
+            sink.hasEvents = true;
+        }
+        sink.pending.clear();
+        if (sink.file && sink.hasEvents && rotationDue(sink)) {
+            rotate(sink);
+        } else if (flush && sink.file) {
+            fflush(sink.file);
+        }
+    }
+    
+    bool rotationDue(const Sink& sink) const {
+        if (rotation.maxBytes > 0 && sink.bytes >= rotation.maxBytes) return true;
+        long long maxAgeNanos = chrono::duration_cast<chrono::nanoseconds>(rotation.maxAge).count();
+        return maxAgeNanos > 0 && ClockService::monotonicNanos() - sink.openedAt >= maxAgeNanos;
+    }
+    
+    // 同一秒内多次轮转时追加序号
+    static string segmentName(const string& path) {
+        time_t now = time(nullptr);
+        struct tm local;
+        localtime_r(&now, &local);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+        string name = path + "." + stamp;
+        error_code ec;
+        for (int i = 1; filesystem::exists(name, ec) || filesystem::exists(name + ".gz", ec); i++) {
+            name = path + "." + stamp + "-" + to_string(i);
+        }
+        return name;
+    }
+    
+    // 关闭当前段并改名, 交给归档线程压缩; 新段以文件头和 LOG_START 开始; 持有 mtx
+    void rotate(Sink& sink) {
+        fclose(sink.file);
+        string segment = segmentName(sink.path);
+        if (rename(sink.path.c_str(), segment.c_str()) == 0) {
+            archiver.submit(segment, sink.path, rotation);
+            sink.file = fopen(sink.path.c_str(), "wb");
+        } else {
+            sink.file = fopen(sink.path.c_str(), "ab");
+        }
+        startSegment(sink);
+        if (sink.file) sink.bytes += fwrite(sink.preamble.data(), 1, sink.preamble.size(), sink.file);
+    }
+    
+    // 新段写入 EVENT_LOG_MAGIC; 每次打开都记录墙上时间偏移, 追加写入的文件可能跨越多次运行甚至重启
+    void startSegment(Sink& sink) {
+        sink.openedAt = ClockService::monotonicNanos();
+        sink.hasEvents = false;
+        sink.bytes = 0;
+        if (!sink.file) return;
+        sink.bytes = ftell(sink.file);
+        if (sink.bytes == 0) {
+            sink.bytes += fwrite(EVENT_LOG_MAGIC, 1, sizeof(EVENT_LOG_MAGIC), sink.file);
+        }
+        EventRecord sync = makeClockSync(sink.openedAt, ClockService::instance().getWallOffset());
+        sink.bytes += fwrite(&sync, 1, sizeof(sync), sink.file);
+    }
+    
+    void writerLoop() {
+        unique_lock<mutex> lock(mtx);
+        while (true) {
+            if (retune) {
+                retune = false;
+                tuning.applyAuxiliary();
+            }
+            drainRequested = false;
+            drainLocked();
+            // 打开文件期间释放过 mtx, 期间写入的记录要在关闭 sink 之前取出, 否则会写进复用同一编号的 sink
+            if (openPendingSinks(lock)) drainLocked();
+            for (size_t id = 0; id < sinks.size(); id++) {
+                Sink& sink = sinks[id];
+                if (sink.path.empty()) continue;
+                writeOut(sink, true);
+                if (sink.users == 0) closeSink(id);
+            }
+            if (flushCompleted != flushRequested) {
+                flushCompleted = flushRequested;
+                flushedCv.notify_all();
+            }
+            if (stopping) break;
+            cv.wait_for(lock, FLUSH_INTERVAL, [this] {
+                return stopping || retune || drainRequested || flushCompleted != flushRequested;
+            });
+        }
+    }
+    
+    // 打开有待写内容的新 sink; 大量打开(并清空)文件较慢, 期间释放 mtx, 以免阻塞正在登记 sink 的线程
+    // 返回是否释放过 mtx
+    bool openPendingSinks(unique_lock<mutex>& lock) {
+        struct Opening {
+            int id;
+            string path;
+            bool truncate;
+            FILE* file;
+        };
+        vector<Opening> openings;
+        for (size_t id = 0; id < sinks.size(); id++) {
+            const Sink& sink = sinks[id];
+            if (!sink.path.empty() && !sink.opened && !sink.pending.empty()) {
+                openings.push_back({(int)id, sink.path, sink.truncate, nullptr});
+            }
+        }
+        if (openings.empty()) return false;
+        
+        lock.unlock();
+        for (auto& opening : openings) {
+            opening.file = fopen(opening.path.c_str(), opening.truncate ? "wb" : "ab");
+        }
+        lock.lock();
+        
+        // 期间 sink 可能被释放后重新登记, 或改为需要清空, 这时放弃这次打开的文件, 下一轮重新打开
+        for (auto& opening : openings) {
+            Sink& sink = sinks[opening.id];
+            if (sink.path == opening.path && !sink.opened && sink.truncate == opening.truncate) {
+                sink.file = opening.file;
+                sink.opened = true;
+                startSegment(sink);
+            } else if (opening.file) {
+                fclose(opening.file);
+            }
+        }
+        return true;
+    }
+    
+    // 关闭不再使用的 sink, 编号留给之后打开的 sink; 持有 mtx
+    void closeSink(int id) {
+        Sink& sink = sinks[id];
+        if (sink.file) fclose(sink.file);
+        sinkIds.erase(sink.path);
+        sink = Sink{};
+        freeSinkIds.push_back(id);
+    }
+    
+    AsyncLogger() : flushRequested(0), flushCompleted(0), stopping(false), retune(false), drainRequested(false) {
+        writer = thread(&AsyncLogger::writerLoop, this);
+    }
+    
+public:
+    static AsyncLogger& instance() {
+        static AsyncLogger logger;
+        return logger;
+    }
+    
+    ~AsyncLogger() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (writer.joinable()) writer.join();
+        for (auto& sink : sinks) {
+            if (sink.file) fclose(sink.file);
+        }
+    }
+    
+    // 登记(或共用已登记的)日志文件, 返回 sink 编号, 用完后调用 releaseSink; truncate 为真时清空已有内容
+    // 文件由写线程在第一次写出时打开, 调用者不做文件 I/O
+    int openSink(const string& path, bool truncate) {
+        lock_guard<mutex> lock(mtx);
+        auto it = sinkIds.find(path);
+        if (it != sinkIds.end()) {
+            Sink& sink = sinks[it->second];
+            sink.users++;
+            if (truncate) {
+                if (sink.file) fclose(sink.file);
+                sink.file = nullptr;
+                sink.opened = false;
+                sink.truncate = true;
+                sink.pending.clear();
+                sink.preamble.clear();
+            }
+            return it->second;
+        }
+        
+        int id;
+        if (!freeSinkIds.empty()) {
+            id = freeSinkIds.back();
+            freeSinkIds.pop_back();
+        } else {
+            id = sinks.size();
+            sinks.emplace_back();
+        }
+        sinks[id] = Sink{path, nullptr, string(), string(), 0, 0, false, false, truncate, 1};
+        sinkIds[path] = id;
+        return id;
+    }
+    
+    // 不再写入此 sink; 最后一个使用者释放后, 写线程写完剩余内容即关闭文件
+    void releaseSink(int id) {
+        lock_guard<mutex> lock(mtx);
+        if (id >= 0 && id < (int)sinks.size() && sinks[id].users > 0) sinks[id].users--;
+    }
+    
+    // 新的轮转设置从下一次写出起生效
+    void setRotation(const LogRotation& newRotation) {
+        lock_guard<mutex> lock(mtx);
+        rotation = newRotation;
+    }
+    
+    // 记录一个事件; 只写入本线程的缓冲区, 缓冲区满时等待写线程取走
+    void write(int sink, int car, EventCode code, int a = 0, int b = 0, int c = 0) {
+        ThreadBuffer& buffer = localBuffer();
+        size_t tail = buffer.tail.load(memory_order_relaxed);
+        if (tail - buffer.head.load(memory_order_acquire) >= ThreadBuffer::CAPACITY) {
+            unique_lock<mutex> lock(mtx);
+            drainRequested = true;
+            cv.notify_one();
+            spaceCv.wait(lock, [&] {
+                return tail - buffer.head.load(memory_order_acquire) < ThreadBuffer::CAPACITY || stopping;
+            });
+        }
+        
+        Record& record = buffer.records[tail % ThreadBuffer::CAPACITY];
+        record.sink = sink;
+        record.event.timestampNanos = ClockService::monotonicNanos();
+        record.event.car = car;
+        record.event.code = (uint16_t)code;
+        record.event.a = a;
+        record.event.b = b;
+        record.event.c = c;
+        buffer.tail.store(tail + 1, memory_order_release);
+        
+        // 缓冲区过半才唤醒写线程, 其余由定时刷新处理
+        if (tail + 1 - buffer.head.load(memory_order_relaxed) == ThreadBuffer::CAPACITY / 2) {
+            drainRequested = true;
+            cv.notify_one();
+        }
+    }
+    
+    // 等待此前记录的日志全部写入文件
+    void flush() {
+        unique_lock<mutex> lock(mtx);
+        unsigned long long target = ++flushRequested;
+        cv.notify_one();
+        flushedCv.wait(lock, [this, target] { return flushCompleted >= target || stopping; });
+    }
+    
+    // 写线程使用辅助线程的 CPU 绑定
+    void setThreadTuning(const ThreadTuning& threadTuning) {
+        {
+            lock_guard<mutex> lock(mtx);
+            tuning = threadTuning;
+            retune = true;
+        }
+        cv.notify_one();
+        archiver.setThreadTuning(threadTuning);
+    }
+};
+
+// 飞行记录器: 每部电梯和调度器(0 号轨道)各有一个固定大小的环形缓冲区, 保存最近的事件;
+// 缓冲区位于共享映射的文件中, 写入只是内存操作, 不加锁也不进入内核, 进程崩溃后数据仍留在文件里,
+// 可用 --dump-flight 读出
+class FlightRecorder {
+public:
+    static constexpr char MAGIC[8] = {'E', 'L', 'V', 'F', 'L', 'T', '0', '1'};
+    
+    // 文件布局: Header, 然后每条轨道一个 RingHeader 加 capacity 个 Slot
+    struct alignas(64) Header {
+        char magic[8];
+        uint32_t tracks;
+        uint32_t capacity;       // 每条轨道的记录数
+        int64_t wallOffset;      // 创建时的墙上时间偏移, 与 CLOCK_SYNC 含义相同
+    };
+    
+    struct alignas(64) RingHeader {
+        atomic<uint64_t> next;   // 已分配的记录数, 下一条记录写在 next % capacity
+    };
+    
+    // sequence 为记录序号加一, 0 表示空或正在写入; 写到一半崩溃的记录在读出时被跳过
+    struct Slot {
+        atomic<uint64_t> sequence;
+        EventRecord event;
+    };
+    
+    static_assert(sizeof(Slot) == 32, "记录槽应为 32 字节");
+    static_assert(atomic<uint64_t>::is_always_lock_free, "共享映射中的原子变量必须无锁");
+    
+    // 同一电梯的事件可能来自控制线程和发出请求的线程, 用原子计数分配槽位
+    class Ring {
+    private:
+        RingHeader* header;
+        Slot* slots;
+        uint32_t capacity;
+        
+    public:
+        Ring(RingHeader* header, Slot* slots, uint32_t capacity) : header(header), slots(slots), capacity(capacity) {}
+        
+        void record(int car, EventCode code, int a = 0, int b = 0, int c = 0) {
+            uint64_t index = header->next.fetch_add(1, memory_order_relaxed);
+            Slot& slot = slots[index % capacity];
+            slot.sequence.store(0, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+            slot.event.timestampNanos = ClockService::monotonicNanos();
+            slot.event.car = car;
+            slot.event.code = (uint16_t)code;
+            slot.event.a = a;
+            slot.event.b = b;
+            slot.event.c = c;
+            slot.sequence.store(index + 1, memory_order_release);
+        }
+    };
+    
+private:
+    void* base;
+    size_t size;
+    vector<Ring> rings;
+    
+    static size_t ringBytes(uint32_t capacity) {
+        return sizeof(RingHeader) + (size_t)capacity * sizeof(Slot);
+    }
+    
+public:
+    // 创建映射文件; 同名文件改名为 <path>.prev 保留, 以免重启后覆盖崩溃前的记录
+    FlightRecorder(const string& path, uint32_t tracks, uint32_t capacity) : base(MAP_FAILED), size(0) {
+        rename(path.c_str(), (path + ".prev").c_str());
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return;
+        size = sizeof(Header) + tracks * ringBytes(capacity);
+        if (ftruncate(fd, size) == 0) {
+            base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (base == MAP_FAILED) return;
+        
+        // 新扩展的文件内容为零, 即全部槽位为空
+        Header* header = static_cast<Header*>(base);
+        header->tracks = tracks;
+        header->capacity = capacity;
+        header->wallOffset = ClockService::instance().getWallOffset();
+        char* ring = static_cast<char*>(base) + sizeof(Header);
+        for (uint32_t i = 0; i < tracks; i++, ring += ringBytes(capacity)) {
+            rings.emplace_back(reinterpret_cast<RingHeader*>(ring), reinterpret_cast<Slot*>(ring + sizeof(RingHeader)), capacity);
+        }
+        memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    }
+    
+    ~FlightRecorder() {
+        if (base != MAP_FAILED) munmap(base, size);
+    }
+    
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+    
+    bool isOpen() const { return base != MAP_FAILED; }
+    
+    Ring* ring(int track) {
+        return track >= 0 && track < (int)rings.size() ? &rings[track] : nullptr;
+    }
+    
+    // 读出文件中全部完整的记录, 按时间排序
+    static bool load(const string& path, vector<EventRecord>& events, long long& wallOffset) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) return false;
+        Header header;
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                  && header.capacity > 0;
+        if (ok) {
+            wallOffset = header.wallOffset;
+            vector<char> ring(ringBytes(header.capacity));
+            for (uint32_t t = 0; t < header.tracks && fread(ring.data(), ring.size(), 1, file) == 1; t++) {
+                for (uint32_t i = 0; i < header.capacity; i++) {
+                    uint64_t sequence;
+                    EventRecord event;
+                    const char* slot = ring.data() + sizeof(RingHeader) + i * sizeof(Slot);
+                    memcpy(&sequence, slot, sizeof(sequence));
+                    memcpy(&event, slot + offsetof(Slot, event), sizeof(event));
+                    if (sequence != 0 && (sequence - 1) % header.capacity == i) events.push_back(event);
+                }
+            }
+        }
+        fclose(file);
+        stable_sort(events.begin(), events.end(), [](const EventRecord& x, const EventRecord& y) {
+            return x.timestampNanos < y.timestampNanos;
+        });
+        return ok;
+    }
+};
+
+// 一个加锁位置的统计: 加锁次数、争用次数, 等待和持有时间按 2 的幂(微秒)分桶
+struct LockSiteStats {
+    static constexpr int BUCKETS = 20;  // 桶 0: <1 微秒, 桶 k: [2^(k-1), 2^k) 微秒, 最后一个桶不设上限
+    
+    atomic<long long> acquisitions{0};
+    atomic<long long> contended{0};
+    atomic<long long> waitNs{0};
+    atomic<long long> holdNs{0};
+    atomic<long long> maxWaitNs{0};
+    atomic<long long> maxHoldNs{0};
+    atomic<long long> waitHistogram[BUCKETS]{};
+    atomic<long long> holdHistogram[BUCKETS]{};
+    
+    static int bucketOf(long long ns) {
+        long long micros = ns / 1000;
+        int bucket = 0;
+        while (micros > 0 && bucket < BUCKETS - 1) {
+            micros >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+    
+    static void updateMax(atomic<long long>& target, long long value) {
+        long long prev = target;
+        while (value > prev && !target.compare_exchange_weak(prev, value)) {}
+    }
+    
+    void recordWait(long long ns, bool wasContended) {
+        acquisitions++;
+        if (!wasContended) {
+            waitHistogram[0]++;
+            return;
+        }
+        contended++;
+        waitNs += ns;
+        updateMax(maxWaitNs, ns);
+        waitHistogram[bucketOf(ns)]++;
+    }
+    
+    void recordHold(long long ns) {
+        holdNs += ns;
+        updateMax(maxHoldNs, ns);
+        holdHistogram[bucketOf(ns)]++;
+    }
+    
+    // 非零桶按 "<上限:次数" 输出, 单位微秒
+    static string formatHistogram(const atomic<long long> (&histogram)[BUCKETS]) {
+        stringstream ss;
+        for (int i = 0; i < BUCKETS; i++) {
+            long long count = histogram[i];
+            if (count == 0) continue;
+            if (i == BUCKETS - 1) ss << ">=" << (1LL << (i - 1));
+            else ss << "<" << (1LL << i);
+            ss << ":" << count << " ";
+        }
+        return ss.str();
+    }
+};
+
+// 带统计的加锁, 用法同 unique_lock: 先尝试加锁, 失败才计为一次争用并计时等待;
+// 解锁时记录持有时间, 在条件变量上等待期间不计入持有时间
+class ProfiledLock {
+private:
+    unique_lock<mutex> inner;
+    LockSiteStats& stats;
+    chrono::steady_clock::time_point acquiredAt;
+    
+    void recordHold() {
+        stats.recordHold(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - acquiredAt).count());
+    }
+    
+public:
+    ProfiledLock(mutex& m, LockSiteStats& siteStats) : inner(m, defer_lock), stats(siteStats) {
+        lock();
+    }
+    
+    ~ProfiledLock() {
+        if (inner.owns_lock()) unlock();
+    }
+    
+    ProfiledLock(const ProfiledLock&) = delete;
+    ProfiledLock& operator=(const ProfiledLock&) = delete;
+    
+    void lock() {
+        if (inner.try_lock()) {
+            acquiredAt = chrono::steady_clock::now();
+            stats.recordWait(0, false);
+            return;
+        }
+        auto start = chrono::steady_clock::now();
+        inner.lock();
+        acquiredAt = chrono::steady_clock::now();
+        stats.recordWait(chrono::duration_cast<chrono::nanoseconds>(acquiredAt - start).count(), true);
+    }
+    
+    void unlock() {
+        recordHold();
+        inner.unlock();
+    }
+};
+
+// 反应延迟统计: 从事件发生(如触发紧急停止)到控制逻辑做出反应
+struct LatencyStats {
+    atomic<long long> count{0};
+    atomic<long long> totalNs{0};
+    atomic<long long> maxNs{0};
+    
+    void record(long long ns) {
+        count++;
+        totalNs += ns;
+        long long prev = maxNs;
+        while (ns > prev && !maxNs.compare_exchange_weak(prev, ns)) {}
+    }
+    
+    double averageMicros() const {
+        return count > 0 ? totalNs / 1000.0 / count : 0.0;
+    }
+    
+    double maxMicros() const {
+        return maxNs / 1000.0;
+    }
+};
+
+// 全楼紧急状态: 由控制系统持有, 所有电梯共享同一份
+// epoch 每次触发或解除加一, 奇数表示紧急状态生效; 电梯只读取, 不逐部通知
+struct BuildingAlarm {
+    atomic<uint32_t> epoch{0};
+    atomic<long long> raisedAt{0};   // 最近一次触发的时刻(steady_clock 纳秒)
+    atomic<long long> clearedAt{0};  // 最近一次解除的时刻
+    
+    bool active() const { return epoch.load() & 1; }
+};
+
+// 电梯类
+class Elevator {
+private:
+    int id;
+    int currentFloor;
+    ElevatorState state;
+    int minFloor;  // 服务楼层下限(电梯组可能不从1楼开始)
+    int maxFloors;
+    int reachMin;  // 实际可到达的楼层范围, 多轿厢井道中受上下相邻轿厢限制
+    int reachMax;
+    Shaft* shaft;  // 所在的多轿厢井道, 独占井道时为空
+    int shaftSlot;
+    bool parking;  // 正在为井道内其他轿厢让行
+    int parkFloor;
+    int capacity;
+    int currentPassengers;
+    bool doorOpen;
+    bool overloaded;
+    NodePool requestPool;       // 请求节点内存池, 与请求集合一样由 mtx 保护; 乘客只是计数, 没有需要分配的对象
+    FloorSet internalRequests;  // 内部按钮请求
+    HallCallMap externalRequests; // 外部请求: floor -> (upPressed, downPressed)
+    BoundedMpscQueue<InboxEntry, 64> inbox;  // 新请求先无锁放入收件箱, 控制逻辑持有 mtx 时取出登记
+    mutable mutex mtx;
+    mutable LockSiteStats lockStats[(int)LockSite::COUNT];  // 按加锁位置统计 mtx 的争用
+    atomic<bool> running;
+    atomic<bool> emergencyStop;
+    const BuildingAlarm* buildingAlarm;  // 全楼紧急状态, 未接入控制系统时为空
+    atomic<bool> maintenanceMode;
+    string logFile;
+    int logSink;                  // 日志文件在 AsyncLogger 中的编号
+    FlightRecorder::Ring* flightRing;  // 飞行记录器中本电梯的轨道, 未启用时为空
+    // 外部请求被响应或取消后的回调, 在持有 mtx 时调用; 响应时附带开门时刻, 取消时为默认值
+    function<void(int, RequestType, chrono::steady_clock::time_point)> hallCallCleared;
+    function<void()> wakeHook;  // 有新事件时通知外部驱动者(如执行器), 需在启动前设置
+    
+    // 控制状态机的阶段, 每个阶段持续到 phaseDeadline
+    enum class ControlPhase {
+        READY,          // 没有进行中的动作, 决定下一步
+        MOVING,         // 正在驶向相邻楼层
+        DOORS_OPEN,     // 开门停靠, 乘客进出
+        OVERLOAD_HOLD,  // 超载, 等待乘客减少
+        DOORS_CLOSING,  // 正在关门
+        EMERGENCY,
+        MAINTENANCE
+    };
+    ControlPhase phase;
+    chrono::steady_clock::time_point phaseDeadline;
+    chrono::steady_clock::time_point doorsOpenedAt;  // 本次停靠开门的时刻, 呼梯等待时间算到这里
+    int moveDirection;  // 当前这段移动的方向: 1 上行, -1 下行
+    atomic<unsigned long long> stepGeneration;  // driveOn() 登记的 step() 编号, 旧的登记据此作废
+    
+    // 各动作耗时
+    static constexpr chrono::milliseconds FLOOR_TRAVEL_TIME{1000};
+    static constexpr chrono::milliseconds DOOR_DWELL_TIME{2000};
+    static constexpr chrono::milliseconds OVERLOAD_HOLD_TIME{3000};
+    static constexpr chrono::milliseconds DOOR_CLOSE_TIME{1000};
+    static constexpr chrono::milliseconds SHAFT_RETRY_INTERVAL{200};   // 井道被占用时的重试间隔
+    static constexpr chrono::milliseconds HEARTBEAT_GRACE{500};        // 心跳可比预期晚到的时间
+    
+    // 心跳: 每次 step() 结束时记录, 并给出下一次最晚应在何时推进; 等待事件时没有期限
+    // 看门狗发现超过期限仍未推进(如卡在锁或日志 I/O 上)的电梯, 将其标记为停滞, 不再参与派梯
+    atomic<long long> heartbeatAt;
+    atomic<long long> heartbeatDue;
+    atomic<bool> stalled;
+    
+    // 事件发生的时刻(steady_clock 纳秒), 用于计算反应延迟
+    atomic<long long> emergencyRaisedAt;
+    atomic<long long> emergencyClearedAt;
+    atomic<long long> maintenanceClearedAt;
+    LatencyStats emergencyReaction;  // 触发紧急停止 -> 电梯停止
+    LatencyStats resumeReaction;     // 解除紧急停止/维护模式 -> 恢复运行
+    
+    // 统计信息
+    int totalTrips;
+    int totalFloorsTraveled;
+    time_t startTime;
+    atomic<time_t> lastMaintenance;
+    
+    // 记录为固定长度的二进制事件, 文字描述在解码时生成
+    void logEvent(EventCode code, int a = 0, int b = 0, int c = 0) {
+        AsyncLogger::instance().write(logSink, id, code, a, b, c);
+        if (flightRing) flightRing->record(id, code, a, b, c);
+        if (ConsoleLog::isJson()) emitEventJson(id, code, a, b, c);
+    }
+    
+public:
+    // step() 的特殊返回值: 等待新请求或状态变化 / 已停止运行
+    static constexpr chrono::milliseconds WAIT_FOR_EVENT = chrono::milliseconds::max();
+    static constexpr chrono::milliseconds STOPPED = chrono::milliseconds(-1);
+    
+    Elevator(int id, int maxFloors, int capacity, const string& logFilename = "", int minFloor = 1) 
+        : id(id), currentFloor(minFloor), state(ElevatorState::IDLE), minFloor(minFloor), maxFloors(maxFloors), 
+          reachMin(minFloor), reachMax(maxFloors), shaft(nullptr), shaftSlot(-1), parking(false), parkFloor(minFloor),
+          capacity(capacity), currentPassengers(0), doorOpen(false), overloaded(false),
+          internalRequests(less<int>(), PoolAllocator<int>(&requestPool)),
+          externalRequests(less<int>(), PoolAllocator<int>(&requestPool)),
+          running(true), emergencyStop(false), buildingAlarm(nullptr), maintenanceMode(false), flightRing(nullptr),
+          phase(ControlPhase::READY), moveDirection(1), stepGeneration(0),
+          heartbeatAt(0), heartbeatDue(LLONG_MAX), stalled(false),
+          emergencyRaisedAt(0), emergencyClearedAt(0), maintenanceClearedAt(0),
+          totalTrips(0), totalFloorsTraveled(0), startTime(time(nullptr)), lastMaintenance(time(nullptr)) {
+        
+        if (logFilename.empty()) {
+            ostringstream ss;
+            ss << "elevator_" << id << ".evt";
+            logFile = ss.str();
+        } else {
+            logFile = logFilename;
+        }
+        
+        // 日志文件在第一次写出时清空
+        logSink = AsyncLogger::instance().openSink(logFile, true);
+        logEvent(EventCode::LOG_START, capacity, minFloor, maxFloors);
+    }
+
+    ~Elevator() {
+        stop();
+        AsyncLogger::instance().releaseSink(logSink);
+    }
+
+    // 停止控制逻辑: 驱动者下一次推进时 step() 返回 STOPPED; 等待推进结束由驱动者负责(见 ElevatorExecutor::detach)
+    void stop() {
+        // 只在第一次停止时唤醒: 析构时驱动者(执行器或调度器)可能已不存在
+        if (running.exchange(false)) {
+            notifyControl();
+        }
+    }
+    
+    // 由外部驱动者(如执行器)推进状态机时, 用 hook 接收唤醒通知; 需在启动前设置
+    void setWakeHook(function<void()> hook) {
+        wakeHook = hook;
+    }
+
+    bool requestFloor(int floor, RequestType type = RequestType::INTERNAL, bool emergency = false) {
+        if (floor < reachMin || floor > reachMax) {
+            ELEVATOR_LOG_WARN("电梯 " << id << ": 无效楼层 " << floor);
+            return false;
+        }
+
+        if (maintenanceMode && !emergency) {
+            ELEVATOR_LOG_WARN("电梯 " << id << ": 维护模式中，不接受新请求");
+            return false;
+        }
+
+        if (emergency) {
+            // 先唤醒控制逻辑, 控制台输出和日志不计入反应时间
+            emergencyRaisedAt = steadyNanos();
+            emergencyStop = true;
+            notifyControl();
+            ELEVATOR_LOG_WARN("电梯 " << id << ": 紧急停止请求!");
+            logEvent(EventCode::EMERGENCY_REQUEST);
+            return true;
+        }
+
+        // 放入收件箱后立即返回, 不与控制逻辑争用 mtx
+        if (inbox.push({floor, type})) {
+            notifyControl();
+            return true;
+        }
+        
+        // 收件箱已满: 退回到加锁登记, 先取出收件箱中更早的请求以保持顺序
+        ProfiledLock lock(mtx, lockStatsOf(LockSite::REQUEST_FLOOR));
+        drainInbox();
+        registerRequest(floor, type);
+        notifyControl();
+        return true;
+    }
+    
+    // 取出收件箱中的全部请求并登记, 调用时必须持有 mtx
+    void drainInbox() {
+        InboxEntry entry;
+        while (inbox.pop(entry)) {
+            registerRequest(entry.floor, entry.type);
+        }
+    }
+    
+    // 登记一个请求, 调用时必须持有 mtx
+    bool registerRequest(int floor, RequestType type) {
+        if (type == RequestType::INTERNAL) {
+            if (internalRequests.find(floor) == internalRequests.end()) {
+                internalRequests.insert(floor);
+                ELEVATOR_LOG_INFO("电梯 " << id << ": 收到内部请求 " << floor << "楼");
+                logEvent(EventCode::INTERNAL_REQUEST, floor);
+                return true;
+            }
+        } else {
+            // 外部请求
+            if (externalRequests.find(floor) == externalRequests.end()) {
+                externalRequests[floor] = make_pair(false, false);
+            }
+            
+            // 同一楼层同一方向已登记, 重复按键不再输出和记录日志
+            bool& pressed = (type == RequestType::EXTERNAL_UP) ? externalRequests[floor].first : externalRequests[floor].second;
+            if (pressed) {
+                return true;
+            }
+            
+            if (type == RequestType::EXTERNAL_UP) {
+                externalRequests[floor].first = true;
+                ELEVATOR_LOG_INFO("电梯 " << id << ": 收到外部上行请求 " << floor << "楼");
+                logEvent(EventCode::HALL_REQUEST, floor, 1);
+            } else {
+                externalRequests[floor].second = true;
+                ELEVATOR_LOG_INFO("电梯 " << id << ": 收到外部下行请求 " << floor << "楼");
+                logEvent(EventCode::HALL_REQUEST, floor, 2);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // 推进一次控制状态机, 不会阻塞: 完成已到期的动作并开始下一个动作
+    // 返回距下次需要推进的时间; 空闲时返回 WAIT_FOR_EVENT, 停止运行后返回 STOPPED
+    // 同一时刻只能由一个驱动者(执行器或模拟调度器)调用
+    chrono::milliseconds step(chrono::steady_clock::time_point now) {
+        chrono::milliseconds delay = advance(now);
+        publishHeartbeat(delay);
+        return delay;
+    }
+    
+    LockSiteStats& lockStatsOf(LockSite site) const {
+        return lockStats[(int)site];
+    }
+    
+    static const char* lockSiteName(LockSite site) {
+        switch (site) {
+            case LockSite::REQUEST_FLOOR: return "requestFloor";
+            case LockSite::CONTROL: return "control";
+            case LockSite::GET_INTERNAL_REQUESTS: return "getInternalRequests";
+            case LockSite::GET_EXTERNAL_REQUESTS: return "getExternalRequests";
+            default: return "其他";
+        }
+    }
+    
+    // 由看门狗调用: 超过期限仍未推进则标记为停滞, 返回是否是新发现的停滞
+    bool checkHeartbeat(long long nowNanos) {
+        if (!running || heartbeatDue >= nowNanos) return false;
+        return !stalled.exchange(true);
+    }
+    
+    bool isStalled() const { return stalled; }
+    
+    long long getHeartbeatAt() const { return heartbeatAt; }
+    
+private:
+    void publishHeartbeat(chrono::milliseconds delay) {
+        long long nowNanos = steadyNanos();
+        heartbeatAt = nowNanos;
+        if (delay == WAIT_FOR_EVENT || delay == STOPPED) {
+            heartbeatDue = LLONG_MAX;
+        } else {
+            heartbeatDue = nowNanos + chrono::duration_cast<chrono::nanoseconds>(delay + HEARTBEAT_GRACE).count();
+        }
+        if (stalled.exchange(false)) {
+            ELEVATOR_LOG_WARN("电梯 " << id << ": 控制循环恢复响应");
+            logEvent(EventCode::HEARTBEAT_RECOVERED);
+        }
+    }
+    
+    // 有新事件: 控制逻辑应在宽限时间内推进一次
+    void expectHeartbeat() {
+        long long due = steadyNanos() + chrono::duration_cast<chrono::nanoseconds>(HEARTBEAT_GRACE).count();
+        long long current = heartbeatDue;
+        while (due < current && !heartbeatDue.compare_exchange_weak(current, due)) {}
+    }
+    
+    chrono::milliseconds advance(chrono::steady_clock::time_point now) {
+        if (!running) return STOPPED;
+        
+        // 检查紧急停止: 随时打断进行中的动作
+        if (emergencyActive()) {
+            if (phase != ControlPhase::EMERGENCY) enterEmergency();
+            return WAIT_FOR_EVENT;
+        }
+        if (phase == ControlPhase::EMERGENCY) leaveEmergency();
+        
+        // 维护模式中
+        if (phase == ControlPhase::MAINTENANCE) {
+            if (maintenanceMode) return WAIT_FOR_EVENT;
+            leaveMaintenance();
+        }
+        
+        if (now < phaseDeadline) {
+            return chrono::ceil<chrono::milliseconds>(phaseDeadline - now);
+        }
+        
+        ProfiledLock lock(mtx, lockStatsOf(LockSite::CONTROL));
+        drainInbox();
+        switch (phase) {
+            case ControlPhase::MOVING:
+                arrive();
+                // 检查是否有请求在当前楼层
+                if (shouldStopAtCurrentFloor()) {
+                    openDoors();
+                    return enterPhase(ControlPhase::DOORS_OPEN, DOOR_DWELL_TIME, now);
+                }
+                updateState();
+                break;
+            case ControlPhase::DOORS_OPEN:
+                processStop();
+                if (overloaded) {
+                    warnOverload();
+                    return enterPhase(ControlPhase::OVERLOAD_HOLD, OVERLOAD_HOLD_TIME, now);
+                }
+                closeDoors();
+                return enterPhase(ControlPhase::DOORS_CLOSING, DOOR_CLOSE_TIME, now);
+            case ControlPhase::OVERLOAD_HOLD:
+                overloaded = false;
+                closeDoors();
+                return enterPhase(ControlPhase::DOORS_CLOSING, DOOR_CLOSE_TIME, now);
+            case ControlPhase::DOORS_CLOSING:
+                logEvent(EventCode::DOORS_SHUT);
+                // 更新状态
+                updateState();
+                break;
+            default:
+                break;
+        }
+        phase = ControlPhase::READY;
+        
+        // 检查维护模式: 完成当前动作后才进入
+        if (maintenanceMode) {
+            enterMaintenance();
+            return WAIT_FOR_EVENT;
+        }
+        
+        if (!hasPendingWork()) {
+            setState(ElevatorState::IDLE);
+            if (shaft) shaft->releaseClaim(shaftSlot);
+            return WAIT_FOR_EVENT;
+        }
+        
+        // 决定方向
+        if (state == ElevatorState::IDLE) {
+            if (shouldStopAtCurrentFloor()) {
+                openDoors();
+                return enterPhase(ControlPhase::DOORS_OPEN, DOOR_DWELL_TIME, now);
+            }
+            int nextFloor = findNextFloor();
+            setState((nextFloor > currentFloor) ? ElevatorState::MOVING_UP : ElevatorState::MOVING_DOWN);
+        }
+        int target = findNextFloor();
+        followTarget(target);
+        int direction = (state == ElevatorState::MOVING_UP) ? 1 : -1;
+        
+        lock.unlock();
+        
+        // 多轿厢井道: 先占用下一层, 被挡住时请对方让行, 稍后重试
+        if (!reserveNextFloor(direction, target)) {
+            return SHAFT_RETRY_INTERVAL;
+        }
+        
+        // 移动电梯
+        moveDirection = direction;
+        logEvent(EventCode::DEPARTED, currentFloor, direction > 0 ? 1 : 2);
+        return enterPhase(ControlPhase::MOVING, FLOOR_TRAVEL_TIME, now);
+    }
+    
+public:
+    // 本电梯或全楼处于紧急状态
+    bool emergencyActive() const {
+        return emergencyStop || (buildingAlarm && buildingAlarm->active());
+    }
+    
+    // 当前紧急状态是否仅由全楼紧急触发; 此时由控制系统统一输出和记录, 电梯不再逐部输出
+    bool buildingEmergencyOnly() const {
+        return !emergencyStop && buildingAlarm && buildingAlarm->active();
+    }
+    
+    static long long steadyNanos() {
+        return ClockService::monotonicNanos();
+    }
+    
+    chrono::milliseconds enterPhase(ControlPhase next, chrono::milliseconds duration, chrono::steady_clock::time_point now) {
+        phase = next;
+        phaseDeadline = now + duration;
+        if (next == ControlPhase::DOORS_OPEN) doorsOpenedAt = now;
+        return duration;
+    }
+    
+    // 通知控制逻辑有新事件, 交给驱动者(执行器或调度器)尽快推进一次
+    void notifyControl() {
+        expectHeartbeat();
+        if (wakeHook) wakeHook();
+    }
+    
+    bool hasPendingWork() const {
+        return !internalRequests.empty() || hasExternalRequests() || parking || !inbox.empty();
+    }
+    
+    // 在调度器上直接推进 step(), 代替 start()
+    // 调度器使用虚拟时钟时可用于批量仿真
+    void driveOn(SimScheduler& sched) {
+        setWakeHook([this, &sched] { scheduleStep(sched, chrono::milliseconds(0)); });
+        scheduleStep(sched, chrono::milliseconds(0));
+    }
+    
+    // 登记下一次 step(); 之前登记但尚未执行的一次随之作废
+    void scheduleStep(SimScheduler& sched, chrono::milliseconds delay) {
+        unsigned long long generation = ++stepGeneration;
+        sched.postAfter(delay, [this, &sched, generation] {
+            if (stepGeneration != generation) return;
+            auto next = step(sched.now());
+            if (next != STOPPED && next != WAIT_FOR_EVENT) {
+                scheduleStep(sched, next);
+            }
+        });
+    }
+    
+    bool hasExternalRequests() const {
+        for (const auto& req : externalRequests) {
+            if (req.second.first || req.second.second) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // 行驶方向以目标为准: 为井道内其他轿厢让行时, 目标可能在原方向的反方向,
+    // 若仍按原方向申请下一层, 迎面相遇的两部轿厢会互相等待
+    void followTarget(int target) {
+        if (target == -1 || target == currentFloor) return;
+        setState((target > currentFloor) ? ElevatorState::MOVING_UP : ElevatorState::MOVING_DOWN);
+    }
+    
+    // 状态变化同时报告给井道, 相邻轿厢据此判断是否迎面会车
+    void setState(ElevatorState next) {
+        state = next;
+        if (shaft) shaft->report(shaftSlot, next);
+    }
+    
+    bool reserveNextFloor(int direction, int target) {
+        if (!shaft) return true;
+        
+        int next = currentFloor + direction;
+        if (shaft->tryMove(shaftSlot, next)) return true;
+        
+        shaft->requestClearance(shaftSlot, next, target);
+        return false;
+    }
+    
+    int findNextFloor() {
+        // 为井道内其他轿厢让行优先
+        if (parking) return parkFloor;
+        
+        // 优先处理内部请求
+        if (!internalRequests.empty()) {
+            if (state == ElevatorState::MOVING_UP) {
+                auto it = internalRequests.upper_bound(currentFloor);
+                if (it != internalRequests.end()) return *it;
+            } else if (state == ElevatorState::MOVING_DOWN) {
+                auto it = internalRequests.lower_bound(currentFloor);
+                if (it != internalRequests.begin()) return *(--it);
+            }
+            return *internalRequests.begin();
+        }
+        
+        // 处理外部请求
+        int closestFloor = -1;
+        int minDistance = maxFloors + 1;
+        
+        for (const auto& req : externalRequests) {
+            if ((req.second.first && req.first >= currentFloor) || 
+                (req.second.second && req.first <= currentFloor)) {
+                int distance = abs(req.first - currentFloor);
+                if (distance < minDistance) {
+                    minDistance = distance;
+                    closestFloor = req.first;
+                }
+            }
+        }
+        
+        if (closestFloor != -1) return closestFloor;
+        
+        // 如果没有顺路请求，找最近的请求
+        for (const auto& req : externalRequests) {
+            if (req.second.first || req.second.second) {
+                int distance = abs(req.first - currentFloor);
+                if (distance < minDistance) {
+                    minDistance = distance;
+                    closestFloor = req.first;
+                }
+            }
+        }
+        
+        return closestFloor;
+    }
+    
+    bool shouldStopAtCurrentFloor() {
+        // 检查内部请求
+        if (internalRequests.find(currentFloor) != internalRequests.end()) {
+            return true;
+        }
+        
+        // 检查外部请求
+        auto it = externalRequests.find(currentFloor);
+        if (it != externalRequests.end()) {
+            if (state == ElevatorState::MOVING_UP && it->second.first) {
+                return true;
+            }
+            if (state == ElevatorState::MOVING_DOWN && it->second.second) {
+                return true;
+            }
+            if (state == ElevatorState::IDLE && (it->second.first || it->second.second)) {
+                return true;
+            }
+            // 本层就是下一个目标(前方已无请求)时, 反方向的呼梯也要响应, 否则会在该层附近来回往返
+            if ((it->second.first || it->second.second) && findNextFloor() == currentFloor) {
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    void processStop() {
+        // 移除内部请求
+        internalRequests.erase(currentFloor);
+        
+        // 移除外部请求
+        auto it = externalRequests.find(currentFloor);
+        if (it != externalRequests.end()) {
+            bool servedUp = it->second.first && state != ElevatorState::MOVING_DOWN;
+            bool servedDown = it->second.second && state != ElevatorState::MOVING_UP;
+            if (servedUp) it->second.first = false;
+            if (servedDown) it->second.second = false;
+            
+            if (hallCallCleared) {
+                if (servedUp) hallCallCleared(currentFloor, RequestType::EXTERNAL_UP, doorsOpenedAt);
+                if (servedDown) hallCallCleared(currentFloor, RequestType::EXTERNAL_DOWN, doorsOpenedAt);
+            }
+            
+            // 如果没有请求了，移除该楼层
+            if (!it->second.first && !it->second.second) {
+                externalRequests.erase(it);
+            }
+        }
+        
         // 更新统计信息
         totalTrips++;
     }
 
-    void move() {
-        if (state != ElevatorState::MOVING_UP && state != ElevatorState::MOVING_DOWN) 
+    // 完成一段移动, 到达相邻楼层
+    void arrive() {
+        currentFloor += moveDirection;
+        totalFloorsTraveled++;
+        
+        if (shaft) shaft->arrived(shaftSlot, currentFloor);
+        if (parking && currentFloor == parkFloor) {
+            parking = false;
+        }
+        
+        ELEVATOR_LOG_INFO("电梯 " << id << ": 到达 " << currentFloor << "楼");
+        logEvent(EventCode::ARRIVED, currentFloor);
+    }
+
+    void openDoors() {
+        setState(ElevatorState::DOORS_OPEN);
+        doorOpen = true;
+        ELEVATOR_LOG_INFO("电梯 " << id << ": 门在 " << currentFloor << " 楼打开");
+        logEvent(EventCode::DOORS_OPENED, currentFloor);
+        
+        // 模拟乘客进出
+        simulatePassengers();
+    }
+    
+    void warnOverload() {
+        ELEVATOR_LOG_WARN("电梯 " << id << ": 超载警告! 请减少乘客数量");
+        logEvent(EventCode::OVERLOAD);
+    }
+
+    void closeDoors() {
+        ELEVATOR_LOG_INFO("电梯 " << id << ": 门关闭");
+        logEvent(EventCode::DOORS_CLOSED);
+        doorOpen = false;
+    }
+
+    void simulatePassengers() {
+        random_device rd;
+        mt19937 gen(rd());
+        uniform_int_distribution<> enterDis(0, 5);
+        uniform_int_distribution<> exitDis(0, min(5, currentPassengers));
+        
+        int entering = enterDis(gen);
+        int exiting = exitDis(gen);
+        
+        // 确保不超过容量
+        entering = min(entering, capacity - currentPassengers);
+        
+        currentPassengers += entering - exiting;
+        
+        // 检查是否超载
+        if (currentPassengers > capacity) {
+            overloaded = true;
+            currentPassengers = capacity; // 强制减少到容量限制
+        }
+        
+        ELEVATOR_LOG_INFO("电梯 " << id << ": " << entering << "人进入, " << exiting << "人离开, 当前乘客: " << currentPassengers << "/" << capacity);
+        logEvent(EventCode::PASSENGERS, entering, exiting, currentPassengers);
+    }
+
+    void updateState() {
+        if (internalRequests.empty() && !hasExternalRequests() && !parking) {
+            setState(ElevatorState::IDLE);
+        } else {
+            // 决定下一步方向
+            int nextFloor = findNextFloor();
+            if (nextFloor != -1) {
+                setState((nextFloor > currentFloor) ? ElevatorState::MOVING_UP : ElevatorState::MOVING_DOWN);
+            } else {
+                setState(ElevatorState::IDLE);
+            }
+        }
+    }
+
+    void enterEmergency() {
+        bool quiet = buildingEmergencyOnly();
+        long long raisedAt = quiet ? buildingAlarm->raisedAt.load() : emergencyRaisedAt.load();
+        if (raisedAt > 0) emergencyReaction.record(steadyNanos() - raisedAt);
+        
+        if (!quiet) {
+            ELEVATOR_LOG_WARN("电梯 " << id << ": 紧急停止已激活!");
+            logEvent(EventCode::EMERGENCY_ACTIVATED);
+        }
+        
+        // 中断进行中的移动, 释放井道中预占的楼层
+        if (phase == ControlPhase::MOVING && shaft) {
+            shaft->arrived(shaftSlot, currentFloor);
+        }
+        if (shaft) shaft->releaseClaim(shaftSlot);
+        phase = ControlPhase::EMERGENCY;
+        setState(ElevatorState::EMERGENCY_STOP);
+        
+        // 立即开门如果在楼层上
+        if (currentFloor >= minFloor && currentFloor <= maxFloors) {
+            doorOpen = true;
+            if (!quiet) {
+                ELEVATOR_LOG_WARN("电梯 " << id << ": 紧急开门在 " << currentFloor << " 楼");
+                logEvent(EventCode::EMERGENCY_DOORS_OPENED, currentFloor);
+            }
+        }
+    }
+    
+    void leaveEmergency() {
+        long long clearedAt = emergencyClearedAt;
+        bool quiet = false;
+        if (buildingAlarm && buildingAlarm->clearedAt > clearedAt) {
+            // 最后解除的是全楼紧急状态, 已由控制系统统一输出
+            clearedAt = buildingAlarm->clearedAt;
+            quiet = true;
+        }
+        if (clearedAt > 0) resumeReaction.record(steadyNanos() - clearedAt);
+        
+        if (!quiet) {
+            ELEVATOR_LOG_INFO("电梯 " << id << ": 紧急情况解除，恢复正常运行");
+            logEvent(EventCode::EMERGENCY_CLEARED);
+        }
+        phase = ControlPhase::READY;
+        setState(ElevatorState::IDLE);
+        doorOpen = false;
+    }
+    
+    void enterMaintenance() {
+        ELEVATOR_LOG_INFO("电梯 " << id << ": 维护模式中...");
+        phase = ControlPhase::MAINTENANCE;
+        setState(ElevatorState::MAINTENANCE);
+    }
+    
+    void leaveMaintenance() {
+        long long clearedAt = maintenanceClearedAt;
+        if (clearedAt > 0) resumeReaction.record(steadyNanos() - clearedAt);
+        
+        ELEVATOR_LOG_INFO("电梯 " << id << ": 维护模式结束，恢复正常运行");
+        logEvent(EventCode::MAINTENANCE_ENDED);
+        phase = ControlPhase::READY;
+        setState(ElevatorState::IDLE);
+        lastMaintenance = time(nullptr);
+    }
+
+    void resetEmergency() {
+        emergencyClearedAt = steadyNanos();
+        emergencyStop = false;
+        notifyControl();
+    }
+    
+    void setMaintenanceMode(bool mode) {
+        if (!mode) maintenanceClearedAt = steadyNanos();
+        maintenanceMode = mode;
+        notifyControl();
+    }
+    
+    // 加入多轿厢井道, 只能在 [low, high] 内运行, 从 low 层出发; 需在 start() 之前调用
+    void attachShaft(Shaft* s, int low, int high) {
+        ProfiledLock lock(mtx, lockStatsOf(LockSite::OTHER));
+        reachMin = low;
+        reachMax = high;
+        currentFloor = low;
+        shaft = s;
+        shaftSlot = s->attach(this, low);
+    }
+    
+    // 移动到 floor 为井道内其他轿厢让路, 不开门
+    void park(int floor) {
+        ProfiledLock lock(mtx, lockStatsOf(LockSite::OTHER));
+        floor = max(reachMin, min(reachMax, floor));
+        if (floor == currentFloor || (parking && parkFloor == floor)) {
+            return;
+        }
+        parking = true;
+        parkFloor = floor;
+        ELEVATOR_LOG_INFO("电梯 " << id << ": 井道让行, 移至 " << floor << "楼");
+        logEvent(EventCode::SHAFT_YIELD, floor);
+        notifyControl();
+    }
+    
+    bool canReach(int floor) const { return floor >= reachMin && floor <= reachMax; }
+    
+    // 前往 floor 是否需要井道内其他轿厢让行
+    bool isPathBlocked(int floor) const {
+        return shaft && shaft->pathBlocked(shaftSlot, floor);
+    }
+    
+    bool isIdle() const {
+        ProfiledLock lock(mtx, lockStatsOf(LockSite::OTHER));
+        return state == ElevatorState::IDLE && !hasPendingWork();
+    }
+    
+    // 接入全楼紧急状态, 需在 start() 之前调用
+    void setBuildingAlarm(const BuildingAlarm* alarm) {
+        buildingAlarm = alarm;
+    }
+    
+    // 同时把事件写入飞行记录器, 需在 start() 之前调用
+    void setFlightRecorder(FlightRecorder::Ring* ring) {
+        flightRing = ring;
+    }
+    
+    // 全楼紧急状态变化后唤醒控制逻辑, 不输出也不记录日志
+    void wakeForAlarm() {
+        notifyControl();
+    }
+    
+    // 设置外部请求清除回调, 需在 start() 之前调用
+    void setHallCallListener(function<void(int, RequestType, chrono::steady_clock::time_point)> listener) {
+        hallCallCleared = listener;
+    }
+    
+    // 撤销一个内部或外部请求: 从行程中移除并重新规划方向, 不再为该楼层停靠开门
+    bool cancelRequest(int floor, RequestType type = RequestType::INTERNAL) {
+        ProfiledLock lock(mtx, lockStatsOf(LockSite::OTHER));
+        drainInbox();
+        
+        if (type == RequestType::INTERNAL) {
+            if (internalRequests.erase(floor) == 0) {
+                return false;
+            }
+            ELEVATOR_LOG_INFO("电梯 " << id << ": 取消内部请求 " << floor << "楼");
+            logEvent(EventCode::INTERNAL_CANCELLED, floor);
+        } else {
+            auto it = externalRequests.find(floor);
+            if (it == externalRequests.end()) {
+                return false;
+            }
+            bool& pressed = (type == RequestType::EXTERNAL_UP) ? it->second.first : it->second.second;
+            if (!pressed) {
+                return false;
+            }
+            pressed = false;
+            if (!it->second.first && !it->second.second) {
+                externalRequests.erase(it);
+            }
+            
+            ELEVATOR_LOG_INFO("电梯 " << id << ": 取消外部" << (type == RequestType::EXTERNAL_UP ? "上行" : "下行")
+                              << "请求 " << floor << "楼");
+            logEvent(EventCode::HALL_CANCELLED, floor, type == RequestType::EXTERNAL_UP ? 1 : 2);
+            if (hallCallCleared) hallCallCleared(floor, type, chrono::steady_clock::time_point());
+        }
+        
+        // 行驶中重新决定方向, 没有剩余请求时就地转为空闲
+        if (state == ElevatorState::MOVING_UP || state == ElevatorState::MOVING_DOWN) {
+            updateState();
+        }
+        notifyControl();
+        return true;
+    }
+
+    // 获取电梯信息
+    int getId() const { return id; }
+    int getCurrentFloor() const { return currentFloor; }
+    int getMinFloor() const { return minFloor; }
+    int getMaxFloor() const { return maxFloors; }
+    ElevatorState getState() const { return state; }
+    int getPassengerCount() const { return currentPassengers; }
+    int getCapacity() const { return capacity; }
+    // 返回普通容器的副本: 池分配的节点只能在持有 mtx 时申请和释放
+    set<int> getInternalRequests() const { 
+        ProfiledLock lock(mtx, lockStatsOf(LockSite::GET_INTERNAL_REQUESTS));
+        return set<int>(internalRequests.begin(), internalRequests.end()); 
+    }
+    
+    map<int, pair<bool, bool>> getExternalRequests() const {
+        ProfiledLock lock(mtx, lockStatsOf(LockSite::GET_EXTERNAL_REQUESTS));
+        return map<int, pair<bool, bool>>(externalRequests.begin(), externalRequests.end());
+    }
+    
+    bool isFull() const { return currentPassengers >= capacity; }
+    bool isInShaft() const { return shaft != nullptr; }
+    bool isEmergency() const { return emergencyActive(); }
+    bool isInMaintenance() const { return maintenanceMode; }
+    
+    string getStateString() const {
+        switch (state) {
+            case ElevatorState::IDLE: return "空闲";
+            case ElevatorState::MOVING_UP: return "上行";
+            case ElevatorState::MOVING_DOWN: return "下行";
+            case ElevatorState::DOORS_OPEN: return "门开";
+            case ElevatorState::EMERGENCY_STOP: return "紧急停止";
+            case ElevatorState::MAINTENANCE: return "维护中";
+            default: return "未知";
+        }
+    }
+    
+    void printStatistics() const {
+        time_t now = time(nullptr);
+        double hours = difftime(now, startTime) / 3600.0;
+        int floorsPerHour = hours > 0 ? totalFloorsTraveled / hours : 0;
+        
+        ostream& out = ConsoleLog::stream();
+        out << "电梯 " << id << " 统计信息:" << endl;
+        out << "  运行时间: " << fixed << setprecision(1) << hours << " 小时" << endl;
+        out << "  总行程数: " << totalTrips << endl;
+        out << "  总行驶楼层: " << totalFloorsTraveled << endl;
+        out << "  平均行驶楼层/小时: " << floorsPerHour << endl;
+        out << "  紧急停止反应延迟: 平均 " << setprecision(1) << emergencyReaction.averageMicros() << " 微秒, 最大 "
+             << emergencyReaction.maxMicros() << " 微秒 (" << emergencyReaction.count << " 次)" << endl;
+        out << "  恢复运行反应延迟: 平均 " << resumeReaction.averageMicros() << " 微秒, 最大 "
+             << resumeReaction.maxMicros() << " 微秒 (" << resumeReaction.count << " 次)" << endl;
+        
+        out << "  互斥量统计:" << endl;
+        for (int i = 0; i < (int)LockSite::COUNT; i++) {
+            const LockSiteStats& site = lockStats[i];
+            long long count = site.acquisitions;
+            if (count == 0) continue;
+            long long contended = site.contended;
+            out << "    " << lockSiteName((LockSite)i) << ": 加锁 " << count << " 次, 争用 " << contended
+                 << " 次 (" << contended * 100.0 / count << "%), 等待 平均 "
+                 << (contended > 0 ? site.waitNs / 1000.0 / contended : 0.0) << " / 最大 " << site.maxWaitNs / 1000.0
+                 << " 微秒, 持有 平均 " << site.holdNs / 1000.0 / count << " / 最大 " << site.maxHoldNs / 1000.0 << " 微秒" << endl;
+            if (contended > 0) {
+                out << "      等待分布(微秒): " << LockSiteStats::formatHistogram(site.waitHistogram) << endl;
+            }
+            out << "      持有分布(微秒): " << LockSiteStats::formatHistogram(site.holdHistogram) << endl;
+        }
+        
+        out << "  上次维护时间: " << ClockService::format(lastMaintenance) << endl;
+    }
+};
+
+// 挡路的轿厢空闲, 或正迎面驶来且编号更高(低编号轿厢优先)时, 让它停到 target 之外
+void Shaft::requestClearance(int slot, int to, int target) {
+    Elevator* car;
+    int other;
+    int bound;
+    {
+        lock_guard<mutex> lock(mtx);
+        other = findBlocker(slot, to);
+        if (other < 0) return;
+        car = slots[other].car;
+        
+        bool above = other > slot;
+        ElevatorState otherState = slots[other].state;
+        bool headOn = above ? otherState == ElevatorState::MOVING_DOWN : otherState == ElevatorState::MOVING_UP;
+        if (otherState != ElevatorState::IDLE && !(headOn && slot < other)) return;
+        
+        bound = above ? max(target, to) : min(target, to);
+        slots[slot].claim = bound;
+        slots[other].claim = NO_CLAIM;
+    }
+    // park() 取对方的锁, 必须在释放井道锁之后调用
+    int gap = abs(other - slot);
+    car->park(other > slot ? bound + gap : bound - gap);
+}
+
+// 事件循环执行器: 少量固定的工作线程驱动任意多部电梯的控制状态机
+// 电梯在定时到期或收到事件(请求、紧急停止等)时进入就绪队列, 由空闲的工作线程调用 step();
+// 同一部电梯同一时刻只会被一个工作线程推进
+class ElevatorExecutor {
+private:
+    struct Timer {
+        chrono::steady_clock::time_point when;
+        Elevator* car;
+        unsigned long long generation;
+        
+        bool operator>(const Timer& other) const { return when > other.when; }
+    };
+    
+    // 每部电梯的调度状态; generation 变化后, 之前登记的定时器作废
+    struct CarSlot {
+        unsigned long long generation = 0;
+        bool queued = false;  // 已在就绪队列中
+        bool active = false;  // 正在被某个工作线程推进
+        bool rerun = false;   // 推进期间又收到了事件
+    };
+    
+    mutex mtx;
+    condition_variable cv;
+    condition_variable idleCv;  // 一部电梯推进完一次, detach() 在此等待
+    deque<Elevator*> ready;
+    priority_queue<Timer, vector<Timer>, greater<Timer>> timers;
+    unordered_map<Elevator*, CarSlot> slots;
+    vector<thread> workers;
+    bool stopping;
+    
+    void enqueueLocked(Elevator* car, CarSlot& slot) {
+        if (slot.active) {
+            slot.rerun = true;
+        } else if (!slot.queued) {
+            slot.queued = true;
+            ready.push_back(car);
+            cv.notify_one();
+        }
+    }
+    
+    void workerLoop() {
+        unique_lock<mutex> lock(mtx);
+        while (!stopping) {
+            // 到期的定时器转入就绪队列
+            auto now = chrono::steady_clock::now();
+            while (!timers.empty() && timers.top().when <= now) {
+                Timer timer = timers.top();
+                timers.pop();
+                auto it = slots.find(timer.car);
+                if (it != slots.end() && it->second.generation == timer.generation) {
+                    enqueueLocked(timer.car, it->second);
+                }
+            }
+            
+            if (ready.empty()) {
+                if (timers.empty()) {
+                    cv.wait(lock);
+                } else {
+                    cv.wait_until(lock, timers.top().when);
+                }
+                continue;
+            }
+            
+            Elevator* car = ready.front();
+            ready.pop_front();
+            auto found = slots.find(car);
+            if (found == slots.end()) continue;  // 已 detach()
+            CarSlot& slot = found->second;
+            slot.queued = false;
+            slot.active = true;
+            slot.rerun = false;
+            
+            lock.unlock();
+            chrono::milliseconds delay = car->step(chrono::steady_clock::now());
+            lock.lock();
+            
+            CarSlot& done = slots[car];
+            done.active = false;
+            done.generation++;
+            idleCv.notify_all();
+            if (delay == Elevator::STOPPED) {
+                slots.erase(car);
+            } else if (done.rerun) {
+                enqueueLocked(car, done);
+            } else if (delay != Elevator::WAIT_FOR_EVENT) {
+                timers.push({chrono::steady_clock::now() + delay, car, done.generation});
+            }
+        }
+    }
+    
+public:
+    // onThreadStart 在每个工作线程开始时调用, 用于设置 CPU 绑定和调度策略
+    explicit ElevatorExecutor(int threads, function<void()> onThreadStart = nullptr) : stopping(false) {
+        for (int i = 0; i < max(1, threads); i++) {
+            workers.emplace_back([this, onThreadStart] {
+                if (onThreadStart) onThreadStart();
+                workerLoop();
+            });
+        }
+    }
+    
+    ~ElevatorExecutor() {
+        shutdown();
+    }
+    
+    // 由执行器接管电梯的控制逻辑; 一个执行器可同时驱动多个电梯组
+    void attach(Elevator* car) {
+        car->setWakeHook([this, car] { wake(car); });
+        {
+            lock_guard<mutex> lock(mtx);
+            slots[car];
+        }
+        wake(car);
+    }
+    
+    // 不再驱动 car, 等它正在进行的一次推进结束后返回; 之后 car 可以析构
+    void detach(Elevator* car) {
+        unique_lock<mutex> lock(mtx);
+        idleCv.wait(lock, [this, car] {
+            auto it = slots.find(car);
+            return it == slots.end() || !it->second.active;
+        });
+        slots.erase(car);
+        ready.erase(remove(ready.begin(), ready.end(), car), ready.end());
+    }
+    
+    // 电梯有新事件, 尽快推进一次
+    void wake(Elevator* car) {
+        lock_guard<mutex> lock(mtx);
+        if (stopping) return;
+        auto it = slots.find(car);
+        if (it == slots.end()) return;
+        it->second.generation++;
+        enqueueLocked(car, it->second);
+    }
+    
+    // 停止全部工作线程: 排队中的推进和定时器直接丢弃, 空闲线程立即醒来退出,
+    // 忙碌线程做完手上这一次 step() 就退出; step() 从不阻塞, 所以返回时间不超过一次 step()
+    void shutdown() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+            ready.clear();
+            timers = {};
+        }
+        cv.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+        workers.clear();
+    }
+    
+    int getThreadCount() const {
+        return workers.size();
+    }
+};
+
+// 外部呼梯的派梯策略: SCORE 为综合评分(默认), NEAREST 只看距离, ROUND_ROBIN 依次轮流分配;
+// 三者都跳过停滞、紧急停止、维护中和到不了该楼层的电梯
+enum class DispatchPolicy {
+    SCORE,
+    NEAREST,
+    ROUND_ROBIN
+};
+
+inline const char* dispatchPolicyName(DispatchPolicy policy) {
+    switch (policy) {
+        case DispatchPolicy::SCORE: return "score";
+        case DispatchPolicy::NEAREST: return "nearest";
+        case DispatchPolicy::ROUND_ROBIN: return "round-robin";
+    }
+    return "unknown";
+}
+
+inline bool parseDispatchPolicy(const string& name, DispatchPolicy& policy) {
+    for (DispatchPolicy candidate : {DispatchPolicy::SCORE, DispatchPolicy::NEAREST, DispatchPolicy::ROUND_ROBIN}) {
+        if (name == dispatchPolicyName(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 电梯控制系统类
+class ElevatorControlSystem {
+private:
+    unique_ptr<FlightRecorder> flightRecorder;  // 晚于电梯析构
+    FlightRecorder::Ring* systemFlightRing;     // 调度器的轨道
+    vector<unique_ptr<Elevator>> elevators;  // Elevator 含互斥量不可移动, 以指针持有
+    vector<unique_ptr<Shaft>> shafts;        // 多轿厢井道
+    unique_ptr<ElevatorExecutor> executor;   // 单独运行时自己的执行器, 先于电梯析构
+    ElevatorExecutor* driver;                // 正在驱动本系统电梯的执行器(自己的或共享的)
+    int controlThreads;                      // 执行器线程数, 0 表示按 CPU 核数
+    thread monitorThread;                    // 定期输出状态, stop() 时回收
+    thread watchdogThread;                   // 检查各电梯心跳, stop() 时回收
+    ThreadTuning tuning;                     // 控制线程与辅助线程的 CPU 绑定和调度策略
+    mutex mtx;
+    condition_variable monitorCv;            // 用于打断监控线程的等待
+    atomic<bool> running;
+    int minFloor;
+    int maxFloors;
+    string logDir;
+    
+    // 全系统的外部呼梯登记表: 每层一个字节, 按位记录上行/下行是否已在等待
+    // 已登记的呼梯再次按下时只做一次原子操作即返回, 不再评分、输出和记录日志
+    unique_ptr<atomic<uint8_t>[]> pendingHallCalls;
+    unique_ptr<atomic<int>[]> hallCallOwner;  // 每层每方向的呼梯分配给了哪部电梯(下标)
+    atomic<long long> coalescedPresses;
+    DispatchPolicy dispatchPolicy;
+    atomic<unsigned> roundRobinNext;          // ROUND_ROBIN 下一次从哪部电梯开始
+    BuildingAlarm alarm;                      // 全楼紧急状态, 各电梯共享读取
+    
+    // 外部呼梯等待时间: 登记时记下时刻, 电梯到达清除时计入统计; 撤销的呼梯不计入
+    unique_ptr<atomic<long long>[]> hallCallRaisedAt;
+    LatencyStats hallCallWait;
+    SimScheduler* clockSource;                // 由调度器驱动时使用它的时钟(可能是虚拟时钟)
+    int systemLogSink;                        // system.evt 在 AsyncLogger 中的编号
+    
+    long long clockNanos() const {
+        auto now = clockSource ? clockSource->now() : chrono::steady_clock::now();
+        return chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch()).count();
+    }
+    
+    atomic<long long>& raisedAtOf(int floor, RequestType type) {
+        return hallCallRaisedAt[(floor - minFloor) * 2 + (type == RequestType::EXTERNAL_DOWN ? 1 : 0)];
+    }
+    
+    // 电梯清除了外部呼梯(到达或撤销); 等待时间算到开门, 与日志中 DISPATCHED 到 DOORS_OPENED 的口径一致
+    // 呼梯已改派给其他电梯时, 原电梯的清除不算数
+    void onHallCallCleared(int elevatorIndex, int floor, RequestType type, chrono::steady_clock::time_point answeredAt) {
+        if (ownerOf(floor, type) != elevatorIndex) return;
+        long long raisedAt = raisedAtOf(floor, type).exchange(0);
+        if (raisedAt > 0 && answeredAt != chrono::steady_clock::time_point()) {
+            hallCallWait.record(chrono::duration_cast<chrono::nanoseconds>(answeredAt.time_since_epoch()).count() - raisedAt);
+        }
+        clearHallCall(floor, type);
+    }
+    
+    atomic<int>& ownerOf(int floor, RequestType type) {
+        return hallCallOwner[(floor - minFloor) * 2 + (type == RequestType::EXTERNAL_DOWN ? 1 : 0)];
+    }
+    
+    static uint8_t hallCallBit(RequestType type) {
+        return type == RequestType::EXTERNAL_UP ? 1 : 2;
+    }
+    
+    void clearHallCall(int floor, RequestType type) {
+        pendingHallCalls[floor - minFloor].fetch_and(~hallCallBit(type));
+    }
+    
+    static int hallDirectionCode(RequestType type) {
+        return type == RequestType::EXTERNAL_UP ? 1 : type == RequestType::EXTERNAL_DOWN ? 2 : 0;
+    }
+    
+    // 控制系统级别的日志(如全楼紧急停止), 与各电梯日志放在同一目录
+    void logSystemEvent(EventCode code, int car = 0, int a = 0, int b = 0) {
+        AsyncLogger::instance().write(systemLogSink, car, code, a, b);
+        if (systemFlightRing) systemFlightRing->record(car, code, a, b);
+        if (ConsoleLog::isJson()) emitEventJson(car, code, a, b, 0);
+    }
+    
+public:
+    ElevatorControlSystem(int numElevators, int maxFloors, int capacity, const string& logDirectory = "logs", int minFloor = 1) 
+        : systemFlightRing(nullptr), driver(nullptr), controlThreads(0), running(true), minFloor(minFloor), maxFloors(maxFloors), logDir(logDirectory),
+          pendingHallCalls(new atomic<uint8_t>[maxFloors - minFloor + 1]()),
+          hallCallOwner(new atomic<int>[(maxFloors - minFloor + 1) * 2]()), coalescedPresses(0),
+          dispatchPolicy(DispatchPolicy::SCORE), roundRobinNext(0),
+          hallCallRaisedAt(new atomic<long long>[(maxFloors - minFloor + 1) * 2]()), clockSource(nullptr) {
+        
+        // 创建日志目录
+        error_code ec;
+        filesystem::create_directories(logDir, ec);
+        systemLogSink = AsyncLogger::instance().openSink(logDir + "/system.evt", false);
+        
+        for (int i = 0; i < numElevators; i++) {
+            string logFile = logDir + "/elevator_" + to_string(i+1) + ".evt";
+            elevators.push_back(make_unique<Elevator>(i + 1, maxFloors, capacity, logFile, minFloor));
+            elevators.back()->setHallCallListener([this, i](int floor, RequestType type, chrono::steady_clock::time_point answeredAt) {
+                onHallCallCleared(i, floor, type, answeredAt);
+            });
+            elevators.back()->setBuildingAlarm(&alarm);
+        }
+    }
+
+    // 设置驱动电梯的执行器线程数, 需在 start() 之前调用
+    void setControlThreads(int threads) {
+        controlThreads = threads;
+    }
+    
+    // 设置线程的 CPU 绑定和调度策略, 需在 start() 之前调用
+    void setThreadTuning(const ThreadTuning& threadTuning) {
+        tuning = threadTuning;
+    }
+    
+    // 设置外部呼梯的派梯策略, 需在 start() 之前调用
+    void setDispatchPolicy(DispatchPolicy policy) {
+        dispatchPolicy = policy;
+    }
+    
+    // 在日志目录下创建 flight.rec, 每部电梯和调度器各保存最近 eventsPerTrack 条事件; 需在 start() 之前调用
+    bool enableFlightRecorder(uint32_t eventsPerTrack) {
+        auto recorder = make_unique<FlightRecorder>(logDir + "/flight.rec", elevators.size() + 1, eventsPerTrack);
+        if (!recorder->isOpen()) return false;
+        flightRecorder = move(recorder);
+        systemFlightRing = flightRecorder->ring(0);
+        for (auto& elevator : elevators) {
+            elevator->setFlightRecorder(flightRecorder->ring(elevator->getId()));
+        }
+        return true;
+    }
+
+    void start() {
+        // 全部电梯由执行器的少量线程驱动, 而不是每部电梯一个线程
+        int threads = controlThreads;
+        if (threads <= 0) {
+            threads = min<int>(max(1u, thread::hardware_concurrency()), elevators.size());
+        }
+        function<void()> onThreadStart;
+        if (!tuning.empty()) {
+            onThreadStart = [this] { tuning.applyControl(); };
+        }
+        executor = make_unique<ElevatorExecutor>(threads, onThreadStart);
+        startOn(*executor);
+        
+        if (!tuning.empty()) {
+            AsyncLogger::instance().setThreadTuning(tuning);
+        }
+        monitorThread = thread([this] {
+            tuning.applyAuxiliary();
+            monitor();
+        });
+        watchdogThread = thread([this] {
+            tuning.applyAuxiliary();
+            watchdog();
+        });
+    }
+
+    // 由多个电梯组共享的执行器驱动全部电梯; 不启动监控和看门狗线程,
+    // 由调用者定期调用 checkHeartbeats() 和 printStatus()
+    void startOn(ElevatorExecutor& shared) {
+        driver = &shared;
+        for (auto& elevator : elevators) {
+            driver->attach(elevator.get());
+        }
+    }
+
+    // 全部电梯在调度器上按 step() 推进, 由调用者驱动调度器; 不启动监控线程
+    void driveOn(SimScheduler& sched) {
+        clockSource = &sched;
+        for (auto& elevator : elevators) {
+            elevator->driveOn(sched);
+        }
+    }
+
+    ~ElevatorControlSystem() {
+        stop();
+        AsyncLogger::instance().releaseSink(systemLogSink);
+    }
+
+    // 停止全部电梯和监控线程, 等待线程退出后返回; 可重复调用
+    void stop() {
+        {
+            lock_guard<mutex> lock(mtx);
+            running = false;
+        }
+        monitorCv.notify_all();
+        
+        for (auto& elevator : elevators) {
+            elevator->stop();
+        }
+        if (executor) {
+            executor->shutdown();
+        } else if (driver) {
+            // 共享的执行器继续运行, 只移除本系统的电梯
+            for (auto& elevator : elevators) {
+                driver->detach(elevator.get());
+            }
+        }
+        driver = nullptr;
+        if (monitorThread.joinable()) {
+            monitorThread.join();
+        }
+        if (watchdogThread.joinable()) {
+            watchdogThread.join();
+        }
+        AsyncLogger::instance().flush();
+        cout.flush();
+    }
+
+    void requestElevator(int floor, RequestType type = RequestType::INTERNAL, bool emergency = false, int preferredElevator = -1) {
+        if (floor < minFloor || floor > maxFloors) {
+            ConsoleLog::stream() << "无效楼层: " << floor << endl;
+            return;
+        }
+
+        if (emergency) {
+            raiseBuildingEmergency(floor);
+            return;
+        }
+
+        // 外部呼梯已在等待: 合并重复按键
+        if (type != RequestType::INTERNAL) {
+            uint8_t bit = hallCallBit(type);
+            if (pendingHallCalls[floor - minFloor].fetch_or(bit) & bit) {
+                // 负责的电梯已退出派梯(维护、停滞、紧急状态)时按新呼梯处理, 否则这层永远等不到电梯
+                if (isDispatchable(ownerOf(floor, type)) || !reassignHallCall(floor, type)) {
+                    coalescedPresses++;
+                }
+                return;
+            }
+            raisedAtOf(floor, type) = clockNanos();
+        }
+
+        if (preferredElevator > 0 && preferredElevator <= elevators.size()) {
+            // 指定电梯
+            if (type != RequestType::INTERNAL) {
+                ownerOf(floor, type) = preferredElevator - 1;
+            }
+            if (!elevators[preferredElevator-1]->requestFloor(floor, type) && type != RequestType::INTERNAL) {
+                clearHallCall(floor, type);
+            }
+            ELEVATOR_LOG_INFO("分配请求 " << floor << "楼 给电梯 " << preferredElevator);
+            logSystemEvent(EventCode::DISPATCHED, preferredElevator, floor, hallDirectionCode(type));
             return;
+        }
+
+        // 选择最合适的电梯
+        int bestElevator = findBestElevator(floor, type);
+        if (type != RequestType::INTERNAL) {
+            ownerOf(floor, type) = bestElevator;
+        }
+        if (!elevators[bestElevator]->requestFloor(floor, type) && type != RequestType::INTERNAL) {
+            // 电梯拒绝了请求(如维护中), 撤销登记以便下次按键重新分配
+            clearHallCall(floor, type);
+        }
+        
+        ELEVATOR_LOG_INFO("分配请求 " << floor << "楼 给电梯 " << (bestElevator + 1));
+        logSystemEvent(EventCode::DISPATCHED, bestElevator + 1, floor, hallDirectionCode(type));
+    }
+
+    // 电梯退出派梯后, 把分配给它且尚未响应的呼梯交还, 改派给其他电梯
+    void handBackHallCalls(int elevatorIndex) {
+        for (int floor = minFloor; floor <= maxFloors; floor++) {
+            for (RequestType type : {RequestType::EXTERNAL_UP, RequestType::EXTERNAL_DOWN}) {
+                if ((pendingHallCalls[floor - minFloor] & hallCallBit(type)) && ownerOf(floor, type) == elevatorIndex) {
+                    reassignHallCall(floor, type);
+                }
+            }
+        }
+    }
+
+    // 让多部电梯共用一个井道, elevatorIds 自下而上排列; 需在 start() 之前调用
+    // 第 i 部轿厢只能在 [minFloor + i, maxFloors - (n - 1 - i)] 内运行
+    bool shareShaft(const vector<int>& elevatorIds) {
+        int n = elevatorIds.size();
+        if (n < 2 || n > maxFloors - minFloor + 1) {
+            ConsoleLog::stream() << "无效的井道配置" << endl;
+            return false;
+        }
+        for (int id : elevatorIds) {
+            if (id <= 0 || id > (int)elevators.size() || elevators[id - 1]->isInShaft()) {
+                ConsoleLog::stream() << "无效的电梯ID: " << id << endl;
+                return false;
+            }
+        }
+        
+        shafts.push_back(make_unique<Shaft>());
+        for (int i = 0; i < n; i++) {
+            elevators[elevatorIds[i] - 1]->attachShaft(shafts.back().get(), minFloor + i, maxFloors - (n - 1 - i));
+        }
+        return true;
+    }
+
+    // 电梯已处理完全部请求并停在 floor
+    bool isIdleAt(int elevatorId, int floor) const {
+        const Elevator& elevator = *elevators[elevatorId - 1];
+        return elevator.isIdle() && elevator.getCurrentFloor() == floor;
+    }
+
+    // 撤销外部呼梯: 通知被分配的电梯移除该请求, 登记表由电梯的回调清除
+    bool cancelHallCall(int floor, RequestType type) {
+        if (floor < minFloor || floor > maxFloors || type == RequestType::INTERNAL) {
+            ConsoleLog::stream() << "无效的呼梯: " << floor << endl;
+            return false;
+        }
+        if (!(pendingHallCalls[floor - minFloor] & hallCallBit(type))) {
+            return false;
+        }
+        raisedAtOf(floor, type) = 0;
+        return elevators[ownerOf(floor, type)]->cancelRequest(floor, type);
+    }
+    
+    // 撤销指定电梯内的楼层请求
+    bool cancelCarCall(int elevatorId, int floor) {
+        if (elevatorId <= 0 || elevatorId > (int)elevators.size()) {
+            ConsoleLog::stream() << "无效的电梯ID" << endl;
+            return false;
+        }
+        return elevators[elevatorId - 1]->cancelRequest(floor, RequestType::INTERNAL);
+    }
+    
+    // 把外部呼梯改派给另一部电梯
+    bool reassignHallCall(int floor, RequestType type, int elevatorId) {
+        if (elevatorId <= 0 || elevatorId > (int)elevators.size()) {
+            ConsoleLog::stream() << "无效的电梯ID" << endl;
+            return false;
+        }
+        if (!cancelHallCall(floor, type)) {
+            return false;
+        }
+        requestElevator(floor, type, false, elevatorId);
+        return true;
+    }
+
+    int findBestElevator(int floor, RequestType type) {
+        int bestIndex = 0;
+        int bestScore = INT_MAX;
+        
+        if (dispatchPolicy == DispatchPolicy::ROUND_ROBIN) {
+            unsigned start = roundRobinNext++;
+            for (size_t k = 0; k < elevators.size(); k++) {
+                int i = (start + k) % elevators.size();
+                if (calculateElevatorScore(i, floor, type) != INT_MAX) return i;
+            }
+            return start % elevators.size();
+        }
+
+        for (int i = 0; i < elevators.size(); i++) {
+            int score = calculateElevatorScore(i, floor, type);
+            if (score < bestScore) {
+                bestScore = score;
+                bestIndex = i;
+            }
+        }
 
-        // 模拟移动时间
-        this_thread::sleep_for(chrono::seconds(1));
+        return bestIndex;
+    }
+
+    // 电梯处于紧急状态、维护模式或控制循环停滞时不参与派梯
+    bool isDispatchable(int elevatorIndex) const {
+        const Elevator& elevator = *elevators[elevatorIndex];
+        return !elevator.isStalled() && !elevator.isEmergency() && !elevator.isInMaintenance();
+    }
+    
+    // 把等待中的呼梯改派给当前最合适的电梯, 等待时间仍从第一次按键算起; 没有可用电梯时返回 false, 保留原分配
+    bool reassignHallCall(int floor, RequestType type) {
+        int best = findBestElevator(floor, type);
+        if (calculateElevatorScore(best, floor, type) == INT_MAX) return false;
+        
+        // 先改登记再撤销, 原电梯撤销时的回调不会清掉登记; 停滞的电梯可能一直持有锁, 不去撤销
+        int previous = ownerOf(floor, type).exchange(best);
+        if (previous != best && !elevators[previous]->isStalled()) {
+            elevators[previous]->cancelRequest(floor, type);
+        }
+        if (!elevators[best]->requestFloor(floor, type)) {
+            clearHallCall(floor, type);
+        }
+        
+        ELEVATOR_LOG_INFO("改派请求 " << floor << "楼 从电梯 " << (previous + 1) << " 给电梯 " << (best + 1));
+        logSystemEvent(EventCode::DISPATCHED, best + 1, floor, hallDirectionCode(type));
+        return true;
+    }
+    
+    int calculateElevatorScore(int elevatorIndex, int targetFloor, RequestType type) {
+        const Elevator& elevator = *elevators[elevatorIndex];
+        
+        if (!isDispatchable(elevatorIndex)) {
+            return INT_MAX;
+        }
+        
+        // 多轿厢井道中到不了该楼层的轿厢不参与分配
+        if (!elevator.canReach(targetFloor)) {
+            return INT_MAX;
+        }
+        
+        int currentFloor = elevator.getCurrentFloor();
+        ElevatorState state = elevator.getState();
+        int passengerCount = elevator.getPassengerCount();
+        int capacity = elevator.getCapacity();
         
-        int oldFloor = currentFloor;
+        // 计算距离分数
+        int distance = abs(currentFloor - targetFloor);
+        if (dispatchPolicy == DispatchPolicy::NEAREST) {
+            return distance;
+        }
         
+        // 计算方向分数
+        int directionScore = 0;
         if (state == ElevatorState::MOVING_UP) {
-            currentFloor++;
+            if (currentFloor <= targetFloor) {
+                directionScore = -10; // 同方向且正在接近
+            } else {
+                directionScore = 10; // 反方向
+            }
         } else if (state == ElevatorState::MOVING_DOWN) {
-            currentFloor--;
+            if (currentFloor >= targetFloor) {
+                directionScore = -10; // 同方向且正在接近
+            } else {
+                directionScore = 10; // 反方向
+            }
+        } else if (state == ElevatorState::IDLE) {
+            directionScore = -5; // 空闲电梯
+        }
+        
+        // 计算负载分数
+        int loadScore = (passengerCount * 10) / capacity;
+        
+        // 计算类型适配分数
+        int typeScore = 0;
+        if (type == RequestType::EXTERNAL_UP && state == ElevatorState::MOVING_DOWN) {
+            typeScore = 5; // 上行请求但电梯下行，稍微惩罚
+        } else if (type == RequestType::EXTERNAL_DOWN && state == ElevatorState::MOVING_UP) {
+            typeScore = 5; // 下行请求但电梯上行，稍微惩罚
+        }
+        
+        // 需要井道内其他轿厢让行时, 惩罚
+        int shaftScore = elevator.isPathBlocked(targetFloor) ? 20 : 0;
+        
+        // 总分数 = 距离 + 方向分数 + 负载分数 + 类型适配分数 + 井道分数
+        return distance + directionScore + loadScore + typeScore + shaftScore;
+    }
+
+    static constexpr chrono::milliseconds WATCHDOG_INTERVAL{100};
+    
+    // 看门狗: 定期检查心跳, 停滞的电梯在评分中被排除, 恢复推进后自动重新参与派梯
+    void watchdog() {
+        while (true) {
+            {
+                unique_lock<mutex> lock(mtx);
+                if (monitorCv.wait_for(lock, WATCHDOG_INTERVAL, [this] { return !running; })) break;
+            }
+            checkHeartbeats();
+        }
+    }
+    
+    // 看门狗的一次检查; 共享执行器时由园区控制器统一调用
+    void checkHeartbeats() {
+        long long now = Elevator::steadyNanos();
+        for (auto& elevator : elevators) {
+            if (elevator->checkHeartbeat(now)) {
+                ELEVATOR_LOG_WARN("看门狗: 电梯 " << elevator->getId() << " 控制循环 " << fixed << setprecision(0)
+                                  << (now - elevator->getHeartbeatAt()) / 1e6 << " 毫秒未推进, 暂停派梯");
+                logSystemEvent(EventCode::CAR_STALLED, elevator->getId());
+                handBackHallCalls(elevator->getId() - 1);
+            }
+        }
+    }
+
+    void monitor() {
+        while (true) {
+            {
+                unique_lock<mutex> lock(mtx);
+                if (monitorCv.wait_for(lock, chrono::seconds(10), [this] { return !running; })) break;
+            }
+            printStatus();
+            
+            // 每5分钟保存一次统计信息
+            static int counter = 0;
+            if (++counter % 30 == 0) { // 10s * 30 = 300s = 5min
+                saveStatistics();
+            }
+        }
+    }
+    
+    void saveStatistics() {
+        ofstream statsFile(logDir + "/statistics.txt", ios::trunc);
+        if (statsFile.is_open()) {
+            time_t now = time(nullptr);
+            statsFile << "电梯系统统计信息 - " << ClockService::format(now) << endl;
+            statsFile << "==========================================" << endl;
+            
+            for (const auto& e : elevators) {
+                const Elevator& elevator = *e;
+                time_t startTime = time(nullptr); // 这里应该使用电梯的实际开始时间
+                double hours = difftime(now, startTime) / 3600.0;
+                
+                statsFile << "电梯 " << elevator.getId() << ":" << endl;
+                statsFile << "  运行时间: " << fixed << setprecision(1) << hours << " 小时" << endl;
+                // 这里可以添加更多统计信息
+                statsFile << endl;
+            }
+        }
+    }
+
+    // bank 为所属电梯组的名称, 只用于 JSON 输出
+    void printStatus(const char* bank = nullptr) {
+        if (ConsoleLog::isJson()) {
+            printStatusJson(bank);
+            return;
+        }
+        cout << "\n===== 电梯状态监控 =====" << endl;
+        cout << "时间: " << ClockService::formatNow() << endl;
+        if (alarm.active()) {
+            cout << "全楼紧急状态生效中" << endl;
         }
         
-        totalFloorsTraveled += abs(currentFloor - oldFloor);
+        for (const auto& e : elevators) {
+            const Elevator& elevator = *e;
+            cout << "电梯 " << elevator.getId() << ": ";
+            cout << "楼层 " << elevator.getCurrentFloor() << ", ";
+            cout << elevator.getStateString() << ", ";
+            cout << "乘客: " << elevator.getPassengerCount() << "/" << elevator.getCapacity();
+            
+            if (elevator.isEmergency()) {
+                cout << ", 紧急状态";
+            }
+            
+            if (elevator.isInMaintenance()) {
+                cout << ", 维护模式";
+            }
+            
+            if (elevator.isStalled()) {
+                cout << ", 无响应";
+            }
+            
+            auto internalReqs = elevator.getInternalRequests();
+            if (!internalReqs.empty()) {
+                cout << ", 内部请求: ";
+                for (int floor : internalReqs) {
+                    cout << floor << " ";
+                }
+            }
+            
+            auto externalReqs = elevator.getExternalRequests();
+            if (!externalReqs.empty()) {
+                cout << ", 外部请求: ";
+                for (const auto& req : externalReqs) {
+                    if (req.second.first) cout << req.first << "↑ ";
+                    if (req.second.second) cout << req.first << "↓ ";
+                }
+            }
+            
+            cout << endl;
+        }
+        cout << "合并的重复呼梯: " << coalescedPresses << endl;
+        cout << "呼梯等待: 平均 " << fixed << setprecision(1) << hallCallWait.averageMicros() / 1e6
+             << " 秒, 最长 " << hallCallWait.maxMicros() / 1e6 << " 秒 (" << hallCallWait.count << " 次)" << endl;
+        cout << "=======================\n" << endl;
+    }
+    
+    // 状态快照输出为一行 JSON; 先读取全部电梯的状态再输出, 输出期间不持有电梯的锁
+    void printStatusJson(const char* bank) {
+        struct CarSnapshot {
+            int id;
+            int floor;
+            ElevatorState state;
+            int passengers;
+            int capacity;
+            bool emergency;
+            bool maintenance;
+            bool stalled;
+            set<int> internalRequests;
+            map<int, pair<bool, bool>> externalRequests;
+        };
+        vector<CarSnapshot> cars;
+        cars.reserve(elevators.size());
+        for (const auto& e : elevators) {
+            const Elevator& elevator = *e;
+            cars.push_back({elevator.getId(), elevator.getCurrentFloor(), elevator.getState(), elevator.getPassengerCount(),
+                            elevator.getCapacity(), elevator.isEmergency(), elevator.isInMaintenance(), elevator.isStalled(),
+                            elevator.getInternalRequests(), elevator.getExternalRequests()});
+        }
         
-        cout << "电梯 " << id << ": 到达 " << currentFloor << "楼" << endl;
-        logEvent("到达 " + to_string(currentFloor) + "楼");
+        cout.flush();
+        JsonLineWriter json(stdout);
+        json.field("type", "status");
+        json.field("ts", ClockService::instance().toWallNanos(ClockService::monotonicNanos()));
+        if (bank) json.field("bank", bank);
+        json.field("building_emergency", alarm.active());
+        json.beginArray("cars");
+        for (const CarSnapshot& car : cars) {
+            json.beginObject();
+            json.field("car", car.id);
+            json.field("floor", car.floor);
+            json.field("state", elevatorStateName(car.state));
+            json.field("passengers", car.passengers);
+            json.field("capacity", car.capacity);
+            json.field("emergency", car.emergency);
+            json.field("maintenance", car.maintenance);
+            json.field("stalled", car.stalled);
+            json.beginArray("internal_requests");
+            for (int floor : car.internalRequests) json.element(floor);
+            json.endArray();
+            json.beginArray("hall_up");
+            for (const auto& request : car.externalRequests) {
+                if (request.second.first) json.element(request.first);
+            }
+            json.endArray();
+            json.beginArray("hall_down");
+            for (const auto& request : car.externalRequests) {
+                if (request.second.second) json.element(request.first);
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endArray();
+        json.field("coalesced_presses", coalescedPresses.load());
+        json.field("hall_call_wait_count", hallCallWait.count.load());
+        json.field("hall_call_wait_avg_s", hallCallWait.averageMicros() / 1e6);
+        json.field("hall_call_wait_max_s", hallCallWait.maxMicros() / 1e6);
     }
 
-    void openDoors() {
-        state = ElevatorState::DOORS_OPEN;
-        doorOpen = true;
-        cout << "电梯 " << id << ": 门在 " << currentFloor << " 楼打开" << endl;
-        logEvent("门在 " + to_string(currentFloor) + " 楼打开");
-        
-        // 模拟乘客进出
-        simulatePassengers();
+    // 全楼紧急停止: 翻转一次共享状态并唤醒全部电梯, 输出和日志只各一条
+    void raiseBuildingEmergency(int floor) {
+        // 并发触发时只有一方翻转 epoch; raisedAt 须先于 epoch 写入, 电梯看到生效后据此计算反应延迟
+        uint32_t epoch = alarm.epoch;
+        long long now = Elevator::steadyNanos();
+        do {
+            if (epoch & 1) {
+                ConsoleLog::stream() << "全楼紧急状态已在生效中" << endl;
+                return;
+            }
+            alarm.raisedAt = now;
+        } while (!alarm.epoch.compare_exchange_strong(epoch, epoch + 1));
+        for (auto& elevator : elevators) {
+            elevator->wakeForAlarm();
+        }
         
-        this_thread::sleep_for(chrono::seconds(2));
+        ELEVATOR_LOG_WARN("全楼紧急停止! 触发楼层: " << floor << ", 电梯数: " << elevators.size());
+        logSystemEvent(EventCode::BUILDING_EMERGENCY, 0, floor, elevators.size());
     }
-
-    void closeDoors() {
-        // 检查是否超载
-        if (overloaded) {
-            cout << "电梯 " << id << ": 超载警告! 请减少乘客数量" << endl;
-            logEvent("超载警告");
-            this_thread::sleep_for(chrono::seconds(3));
-            overloaded = false;
+    
+    void resetBuildingEmergency() {
+        uint32_t epoch = alarm.epoch;
+        long long now = Elevator::steadyNanos();
+        do {
+            if (!(epoch & 1)) {
+                ConsoleLog::stream() << "全楼紧急状态未生效" << endl;
+                return;
+            }
+            alarm.clearedAt = now;
+        } while (!alarm.epoch.compare_exchange_strong(epoch, epoch + 1));
+        for (auto& elevator : elevators) {
+            elevator->wakeForAlarm();
         }
         
-        cout << "电梯 " << id << ": 门关闭" << endl;
-        logEvent("门关闭");
-        doorOpen = false;
-        this_thread::sleep_for(chrono::seconds(1));
+        ELEVATOR_LOG_INFO("全楼紧急状态已解除");
+        logSystemEvent(EventCode::BUILDING_EMERGENCY_CLEARED);
+    }
+    
+    bool isBuildingEmergency() const {
+        return alarm.active();
+    }
+    
+    void resetEmergency(int elevatorId) {
+        if (elevatorId == 0) {
+            resetBuildingEmergency();
+        } else if (elevatorId > 0 && elevatorId <= elevators.size()) {
+            elevators[elevatorId - 1]->resetEmergency();
+            ConsoleLog::stream() << "电梯 " << elevatorId << " 紧急状态已重置" << endl;
+        } else {
+            ConsoleLog::stream() << "无效的电梯ID" << endl;
+        }
+    }
+    
+    void setMaintenanceMode(int elevatorId, bool mode) {
+        if (elevatorId > 0 && elevatorId <= elevators.size()) {
+            elevators[elevatorId - 1]->setMaintenanceMode(mode);
+            ConsoleLog::stream() << "电梯 " << elevatorId << " 维护模式" << (mode ? "开启" : "关闭") << endl;
+            if (mode) handBackHallCalls(elevatorId - 1);
+        } else {
+            ConsoleLog::stream() << "无效的电梯ID" << endl;
+        }
+    }
+    
+    void printStatistics(int elevatorId = -1) const {
+        if (elevatorId == -1) {
+            for (const auto& elevator : elevators) {
+                elevator->printStatistics();
+                ConsoleLog::stream() << endl;
+            }
+        } else if (elevatorId > 0 && elevatorId <= elevators.size()) {
+            elevators[elevatorId - 1]->printStatistics();
+        } else {
+            ConsoleLog::stream() << "无效的电梯ID" << endl;
+        }
+    }
+    
+    int getElevatorCount() const {
+        return elevators.size();
+    }
+    
+    long long getCoalescedPresses() const {
+        return coalescedPresses;
+    }
+    
+    const LatencyStats& getHallCallWait() const {
+        return hallCallWait;
+    }
+    
+    int getMinFloor() const {
+        return minFloor;
+    }
+    
+    int getMaxFloors() const {
+        return maxFloors;
     }
+};
 
-    void simulatePassengers() {
-        random_device rd;
-        mt19937 gen(rd());
-        uniform_int_distribution<> enterDis(0, 5);
-        uniform_int_distribution<> exitDis(0, min(5, currentPassengers));
+// 电梯组配置: 一个电梯组是一组服务相同楼层区间的电梯
+struct BankConfig {
+    int building;            // 楼栋编号
+    string name;             // 电梯组名称, 同时用作日志子目录
+    int minFloor;            // 服务楼层下限
+    int maxFloor;            // 服务楼层上限
+    vector<int> entrances;   // 可进入该电梯组候梯厅的入口编号
+    int numElevators;
+    int capacity;
+};
+
+// 园区控制器: 一个进程管理多栋楼的多个电梯组
+// 外部呼梯按 (楼栋, 入口) 找到楼层区间表, 再二分查找楼层所在区间得到候选电梯组,
+// 不需要遍历全部电梯组。电梯组需在 start() 之前通过 addBank() 配置。
+// 全部电梯组共用一个执行器, 监控和看门狗也各只有一个线程, 线程数不随电梯组数增长
+class CampusController {
+private:
+    // 楼层区间: 从 lowFloor 开始到下一区间的 lowFloor 之前, 由 banks 中的电梯组服务
+    struct FloorSegment {
+        int lowFloor;
+        vector<int> banks;
+    };
+    
+    vector<BankConfig> configs;
+    vector<unique_ptr<ElevatorControlSystem>> banks;
+    map<pair<int, int>, vector<int>> banksByEntrance;        // (楼栋, 入口) -> 电梯组
+    map<pair<int, int>, vector<FloorSegment>> segmentIndex;  // (楼栋, 入口) -> 楼层区间表
+    string logRoot;
+    unique_ptr<ElevatorExecutor> executor;  // 驱动全部电梯组的电梯
+    thread monitorThread;
+    thread watchdogThread;
+    mutex mtx;
+    condition_variable cv;                  // 用于打断监控和看门狗线程的等待
+    bool running;
+    
+    // 等待 interval, stop() 时提前返回 false
+    bool waitFor(chrono::milliseconds interval) {
+        unique_lock<mutex> lock(mtx);
+        return !cv.wait_for(lock, interval, [this] { return !running; });
+    }
+    
+    // 重建某个入口的楼层区间表, 区间边界为各电梯组的 minFloor 和 maxFloor + 1
+    void rebuildIndex(const pair<int, int>& key) {
+        const vector<int>& members = banksByEntrance[key];
         
-        int entering = enterDis(gen);
-        int exiting = exitDis(gen);
+        vector<int> bounds;
+        for (int bank : members) {
+            bounds.push_back(configs[bank].minFloor);
+            bounds.push_back(configs[bank].maxFloor + 1);
+        }
+        sort(bounds.begin(), bounds.end());
+        bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
         
-        // 确保不超过容量
-        entering = min(entering, capacity - currentPassengers);
+        vector<FloorSegment> segments;
+        for (int low : bounds) {
+            FloorSegment segment{low, {}};
+            for (int bank : members) {
+                if (configs[bank].minFloor <= low && low <= configs[bank].maxFloor) {
+                    segment.banks.push_back(bank);
+                }
+            }
+            segments.push_back(segment);
+        }
+        // 最后一个边界之后没有电梯组, 其 banks 为空, 作为哨兵
+        segmentIndex[key] = segments;
+    }
+    
+public:
+    CampusController(const string& logDirectory = "logs") : logRoot(logDirectory), running(false) {}
+    
+    ~CampusController() {
+        stop();
+    }
+    
+    // 添加电梯组, 返回电梯组编号
+    int addBank(const BankConfig& config) {
+        if (config.minFloor > config.maxFloor || config.numElevators <= 0) {
+            ConsoleLog::stream() << "无效的电梯组配置: " << config.name << endl;
+            return -1;
+        }
         
-        currentPassengers += entering - exiting;
+        int bankId = banks.size();
+        configs.push_back(config);
+        banks.push_back(make_unique<ElevatorControlSystem>(config.numElevators, config.maxFloor, config.capacity,
+                                                           logRoot + "/" + config.name, config.minFloor));
         
-        // 检查是否超载
-        if (currentPassengers > capacity) {
-            overloaded = true;
-            currentPassengers = capacity; // 强制减少到容量限制
+        for (int entrance : config.entrances) {
+            pair<int, int> key(config.building, entrance);
+            banksByEntrance[key].push_back(bankId);
+            rebuildIndex(key);
+        }
+        return bankId;
+    }
+    
+    void start() {
+        int cars = 0;
+        for (const auto& config : configs) cars += config.numElevators;
+        executor = make_unique<ElevatorExecutor>(min<int>(max(1u, thread::hardware_concurrency()), max(1, cars)));
+        for (auto& bank : banks) {
+            bank->startOn(*executor);
         }
         
-        cout << "电梯 " << id << ": " << entering << "人进入, " << exiting << "人离开, 当前乘客: " << currentPassengers << "/" << capacity << endl;
-        logEvent(to_string(entering) + "人进入, " + to_string(exiting) + "人离开, 当前乘客: " + 
-                 to_string(currentPassengers) + "/" + to_string(capacity));
+        running = true;
+        watchdogThread = thread([this] {
+            while (waitFor(ElevatorControlSystem::WATCHDOG_INTERVAL)) {
+                for (auto& bank : banks) bank->checkHeartbeats();
+            }
+        });
+        monitorThread = thread([this] {
+            // 每 10 秒输出状态, 每 5 分钟保存各电梯组的统计信息
+            for (int round = 1; waitFor(chrono::seconds(10)); round++) {
+                printStatus();
+                if (round % 30 == 0) {
+                    for (auto& bank : banks) bank->saveStatistics();
+                }
+            }
+        });
     }
-
-    void updateState() {
-        if (internalRequests.empty() && !hasExternalRequests()) {
-            state = ElevatorState::IDLE;
-        } else {
-            // 决定下一步方向
-            int nextFloor = findNextFloor();
-            if (nextFloor != -1) {
-                state = (nextFloor > currentFloor) ? ElevatorState::MOVING_UP : ElevatorState::MOVING_DOWN;
-            } else {
-                state = ElevatorState::IDLE;
+    
+    // 停止全部电梯组, 等待线程退出后返回; 可重复调用
+    void stop() {
+        {
+            lock_guard<mutex> lock(mtx);
+            running = false;
+        }
+        cv.notify_all();
+        if (monitorThread.joinable()) monitorThread.join();
+        if (watchdogThread.joinable()) watchdogThread.join();
+        for (auto& bank : banks) {
+            bank->stop();
+        }
+        if (executor) executor->shutdown();
+    }
+    
+    // 查找服务该外部呼梯的电梯组, 没有返回 -1
+    int routeHallCall(int building, int floor, int entrance, RequestType type) const {
+        auto it = segmentIndex.find(make_pair(building, entrance));
+        if (it == segmentIndex.end()) return -1;
+        
+        const vector<FloorSegment>& segments = it->second;
+        auto seg = upper_bound(segments.begin(), segments.end(), floor,
+                               [](int f, const FloorSegment& s) { return f < s.lowFloor; });
+        if (seg == segments.begin()) return -1;
+        --seg;
+        
+        // 多个电梯组重叠(如转换层)时, 选择在请求方向上还能继续运行的电梯组
+        for (int bank : seg->banks) {
+            const BankConfig& config = configs[bank];
+            if (type == RequestType::EXTERNAL_UP && floor >= config.maxFloor) continue;
+            if (type == RequestType::EXTERNAL_DOWN && floor <= config.minFloor) continue;
+            return bank;
+        }
+        return -1;
+    }
+    
+    // 外部呼梯: 从指定楼栋、楼层和入口发起
+    bool requestElevator(int building, int floor, int entrance, RequestType type) {
+        int bank = routeHallCall(building, floor, entrance, type);
+        if (bank < 0) {
+            ConsoleLog::stream() << "楼栋 " << building << " 入口 " << entrance << " 的 " << floor << "楼没有可用电梯组" << endl;
+            return false;
+        }
+        banks[bank]->requestElevator(floor, type);
+        return true;
+    }
+    
+    // 内部请求: 直接发给指定电梯组的指定电梯
+    void requestCarCall(int bankId, int elevatorId, int floor) {
+        if (bankId < 0 || bankId >= (int)banks.size()) {
+            ConsoleLog::stream() << "无效的电梯组ID" << endl;
+            return;
+        }
+        banks[bankId]->requestElevator(floor, RequestType::INTERNAL, false, elevatorId);
+    }
+    
+    void printStatus() {
+        for (size_t i = 0; i < banks.size(); i++) {
+            if (!ConsoleLog::isJson()) {
+                ConsoleLog::stream() << "电梯组 " << configs[i].name << " (楼栋 " << configs[i].building << ", "
+                     << configs[i].minFloor << "-" << configs[i].maxFloor << "楼)" << endl;
             }
+            banks[i]->printStatus(configs[i].name.c_str());
         }
     }
+    
+    ElevatorControlSystem* getBank(int bankId) {
+        if (bankId < 0 || bankId >= (int)banks.size()) return nullptr;
+        return banks[bankId].get();
+    }
+    
+    int getBankCount() const {
+        return banks.size();
+    }
+};
+
+// 从日志中还原的一次请求或撤销, 时间为相对第一条请求的偏移
+struct RecordedRequest {
+    long long offsetNanos;
+    int floor;
+    RequestType type;
+    int car;       // 内部请求所在的电梯, 外部呼梯为 0
+    bool cancel;
+};
+
+// 一次仿真的配置: 一栋楼(一个电梯组)在虚拟时钟下运行 durationMinutes 分钟
+struct ReplicationSpec {
+    string name;
+    int numElevators;
+    int minFloor;
+    int maxFloor;
+    int capacity;
+    int durationMinutes;
+    double callsPerMinute;  // 外部呼梯的平均到达率
+    unsigned seed;
+    DispatchPolicy policy = DispatchPolicy::SCORE;
+    shared_ptr<const vector<RecordedRequest>> requests = nullptr;  // 非空时重放这些请求, 代替随机生成
+};
+
+struct ReplicationResult {
+    string name;
+    unsigned seed;
+    long long hallCalls;
+    double averageWaitSeconds;
+    double maxWaitSeconds;
+    double wallMillis;      // 这次仿真占用的实际时间
+};
 
-    void handleEmergency() {
-        cout << "电梯 " << id << ": 紧急停止已激活!" << endl;
-        logEvent("紧急停止已激活");
-        state = ElevatorState::EMERGENCY_STOP;
+// 批量仿真: 每次仿真是线程池中的一个任务; 同一次仿真的事件前后依赖, 只能在一个线程上顺序推进,
+// 并行只来自不同的仿真. 各工作线程先执行分到的最长仿真, 空闲线程窃取其他线程排队的较短仿真填补尾部
+class SimulationBatch {
+private:
+    // 每次仿真的电梯组和调度器随 Replication 一起释放, 不另设按仿真整体重置的内存区
+    struct Replication {
+        ReplicationSpec spec;
+        SimScheduler sched;
+        unique_ptr<ElevatorControlSystem> system;  // 先于调度器析构
+        chrono::steady_clock::time_point end;
+        ReplicationResult result;
         
-        // 立即开门如果在楼层上
-        if (currentFloor >= 1 && currentFloor <= maxFloors) {
-            doorOpen = true;
-            cout << "电梯 " << id << ": 紧急开门在 " << currentFloor << " 楼" << endl;
-            logEvent("紧急开门在 " + to_string(currentFloor) + " 楼");
-        }
+        Replication(const ReplicationSpec& s) : spec(s), sched(SimScheduler::ClockMode::VIRTUAL), result{} {}
+    };
+    
+    WorkStealingPool pool;
+    string logRoot;
+    vector<unique_ptr<Replication>> replications;
+    
+    // 建立电梯组并按泊松过程预先登记全部外部呼梯
+    void setUp(Replication& rep) {
+        const ReplicationSpec& spec = rep.spec;
+        rep.system = make_unique<ElevatorControlSystem>(spec.numElevators, spec.maxFloor, spec.capacity,
+                                                        logRoot + "/" + spec.name + "_" + to_string(spec.seed),
+                                                        spec.minFloor);
+        rep.system->setDispatchPolicy(spec.policy);
+        rep.system->driveOn(rep.sched);
+        
+        auto start = rep.sched.now();
+        rep.end = start + chrono::minutes(spec.durationMinutes);
         
-        // 等待紧急情况解除
-        while (emergencyStop && running) {
-            this_thread::sleep_for(chrono::seconds(1));
+        // 事件回调只捕获两个指针或同样大小的值, 放得进 function 的内置存储, 登记事件时不再逐个分配
+        ElevatorControlSystem* system = rep.system.get();
+        if (spec.requests) {
+            rep.sched.reserve(spec.requests->size());
+            for (const RecordedRequest& request : *spec.requests) {
+                auto when = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::nanoseconds(request.offsetNanos));
+                // 记录由 spec 持有, 整个仿真期间有效
+                const RecordedRequest* recorded = &request;
+                rep.sched.postAt(when, [system, recorded] {
+                    const RecordedRequest& request = *recorded;
+                    // 电梯数少于记录时, 内部请求按编号折回到现有电梯
+                    int car = request.car > 0 ? (request.car - 1) % system->getElevatorCount() + 1 : 0;
+                    if (request.type == RequestType::INTERNAL) {
+                        if (request.cancel) system->cancelCarCall(car, request.floor);
+                        else system->requestElevator(request.floor, RequestType::INTERNAL, false, car);
+                    } else {
+                        if (request.cancel) system->cancelHallCall(request.floor, request.type);
+                        else system->requestElevator(request.floor, request.type);
+                    }
+                });
+            }
+            return;
         }
         
-        if (running) {
-            cout << "电梯 " << id << ": 紧急情况解除，恢复正常运行" << endl;
-            logEvent("紧急情况解除，恢复正常运行");
-            state = ElevatorState::IDLE;
-            doorOpen = false;
+        rep.sched.reserve((size_t)(spec.callsPerMinute * spec.durationMinutes * 1.2) + 16);
+        mt19937 gen(spec.seed);
+        exponential_distribution<> gapDis(spec.callsPerMinute / 60.0);
+        uniform_int_distribution<> floorDis(spec.minFloor, spec.maxFloor);
+        double t = gapDis(gen);
+        while (t < spec.durationMinutes * 60.0) {
+            int floor = floorDis(gen);
+            RequestType type;
+            if (floor == spec.minFloor) {
+                type = RequestType::EXTERNAL_UP;
+            } else if (floor == spec.maxFloor) {
+                type = RequestType::EXTERNAL_DOWN;
+            } else {
+                type = (gen() & 1) ? RequestType::EXTERNAL_UP : RequestType::EXTERNAL_DOWN;
+            }
+            auto when = start + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(t));
+            rep.sched.postAt(when, [system, floor, type] { system->requestElevator(floor, type); });
+            t += gapDis(gen);
         }
     }
     
-    void handleMaintenance() {
-        cout << "电梯 " << id << ": 维护模式中..." << endl;
-        state = ElevatorState::MAINTENANCE;
+    void runReplication(Replication* rep) {
+        auto wallStart = chrono::steady_clock::now();
+        setUp(*rep);
+        rep->sched.runUntil(rep->end);
         
-        // 等待维护模式结束
-        while (maintenanceMode && running) {
-            this_thread::sleep_for(chrono::seconds(1));
+        const LatencyStats& wait = rep->system->getHallCallWait();
+        rep->result.hallCalls = wait.count;
+        rep->result.averageWaitSeconds = wait.averageMicros() / 1e6;
+        rep->result.maxWaitSeconds = wait.maxMicros() / 1e6;
+        rep->system->stop();
+        rep->system.reset();
+        rep->result.wallMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - wallStart).count();
+    }
+    
+    // 粗略估计仿真用时: 主要开销是每部电梯逐层推进的状态机
+    static double estimatedCost(const ReplicationSpec& spec) {
+        return (double)spec.durationMinutes * spec.numElevators * (spec.maxFloor - spec.minFloor + 1);
+    }
+    
+public:
+    SimulationBatch(int threads, const string& logDirectory = "logs/batch")
+        : pool(threads), logRoot(logDirectory) {}
+    
+    void add(const ReplicationSpec& spec) {
+        replications.push_back(make_unique<Replication>(spec));
+        replications.back()->result.name = spec.name;
+        replications.back()->result.seed = spec.seed;
+    }
+    
+    // 运行全部仿真, 按加入顺序返回结果
+    vector<ReplicationResult> run() {
+        // 任务轮流分到各线程的队列, 线程从队尾取自己的任务、从队首窃取别人的任务;
+        // 按估计用时从短到长提交, 各线程先执行自己最长的仿真, 窃取到的是较短的
+        vector<Replication*> order;
+        for (auto& rep : replications) order.push_back(rep.get());
+        stable_sort(order.begin(), order.end(), [](const Replication* x, const Replication* y) {
+            return estimatedCost(x->spec) < estimatedCost(y->spec);
+        });
+        for (Replication* r : order) {
+            pool.submit([this, r] { runReplication(r); });
         }
+        pool.wait();
         
-        if (running) {
-            cout << "电梯 " << id << ": 维护模式结束，恢复正常运行" << endl;
-            logEvent("维护模式结束，恢复正常运行");
-            state = ElevatorState::IDLE;
-            lastMaintenance = time(nullptr);
+        vector<ReplicationResult> results;
+        for (auto& rep : replications) {
+            results.push_back(rep->result);
         }
+        return results;
+    }
+    
+    int getThreadCount() const {
+        return pool.getThreadCount();
     }
+    
+    long long getStealCount() const {
+        return pool.getStealCount();
+    }
+};
 
-    void resetEmergency() {
-        emergencyStop = false;
-        cv.notify_one();
+// --sim-batch: 几种规模不同的楼宇各运行若干次, 输出每次仿真的呼梯等待时间
+int runSimulationBatch(int repeats, int threads) {
+    const vector<ReplicationSpec> buildings = {
+        {"office", 4, 1, 20, 15, 60, 6.0, 0},
+        {"hotel", 6, 1, 40, 15, 60, 8.0, 0},
+        {"tower", 8, 1, 100, 20, 120, 12.0, 0},
+    };
+    
+    SimulationBatch batch(threads);
+    for (const auto& building : buildings) {
+        for (int i = 0; i < repeats; i++) {
+            ReplicationSpec spec = building;
+            spec.seed = i + 1;
+            batch.add(spec);
+        }
     }
     
-    void setMaintenanceMode(bool mode) {
-        maintenanceMode = mode;
-        if (!mode) {
-            cv.notify_one();
+    auto start = chrono::steady_clock::now();
+    vector<ReplicationResult> results = batch.run();
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    
+    double busy = 0;
+    cout << "\n===== 批量仿真结果 =====" << endl;
+    for (const auto& result : results) {
+        cout << result.name << " #" << result.seed << ": 呼梯 " << result.hallCalls
+             << " 次, 平均等待 " << fixed << setprecision(1) << result.averageWaitSeconds
+             << " 秒, 最长 " << result.maxWaitSeconds << " 秒, 用时 " << result.wallMillis << " 毫秒" << endl;
+        busy += result.wallMillis;
+    }
+    cout << "线程数: " << batch.getThreadCount() << ", 总用时: " << elapsed << " 毫秒, 窃取次数: "
+         << batch.getStealCount() << ", 核心利用率: " << busy / (elapsed * batch.getThreadCount()) * 100 << "%" << endl;
+    return 0;
+}
+
+// --decode: 把二进制事件日志输出为文本或 CSV
+// 读取事件日志文件, 轮转后压缩的 .gz 段直接解压读取
+class EventLogInput {
+private:
+#ifdef ELEVATOR_HAVE_ZLIB
+    gzFile file;
+#else
+    FILE* file;
+    pid_t decompressor;  // 解压 .gz 段的 gzip 进程, 没有则为 -1
+    
+    // 启动 gzip -dc 读取 path, 返回其标准输出
+    FILE* openDecompressed(const string& path) {
+        int fds[2];
+        if (pipe(fds) != 0) return nullptr;
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, fds[0]);
+        posix_spawn_file_actions_addclose(&actions, fds[1]);
+        const char* argv[] = {"gzip", "-dc", "--", path.c_str(), nullptr};
+        int error = posix_spawnp(&decompressor, "gzip", &actions, nullptr, const_cast<char* const*>(argv), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(fds[1]);
+        if (error != 0) {
+            decompressor = -1;
+            close(fds[0]);
+            return nullptr;
+        }
+        return fdopen(fds[0], "rb");
+    }
+#endif
+    
+public:
+    explicit EventLogInput(const string& path) {
+#ifdef ELEVATOR_HAVE_ZLIB
+        file = gzopen(path.c_str(), "rb");
+#else
+        decompressor = -1;
+        bool compressed = path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0;
+        file = compressed ? openDecompressed(path) : fopen(path.c_str(), "rb");
+#endif
+    }
+    
+    ~EventLogInput() {
+#ifdef ELEVATOR_HAVE_ZLIB
+        if (file) gzclose(file);
+#else
+        if (file) fclose(file);
+        if (decompressor > 0) {
+            int status;
+            while (waitpid(decompressor, &status, 0) < 0 && errno == EINTR) {}
         }
+#endif
     }
+    
+    bool isOpen() const { return file != nullptr; }
+    
+    // 读取并校验文件开头的 EVENT_LOG_MAGIC
+    bool readMagic() {
+        char magic[sizeof(EVENT_LOG_MAGIC)];
+        return read(magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, EVENT_LOG_MAGIC, sizeof(magic)) == 0;
+    }
+    
+    // 读取最多 size 字节, 返回实际读取的字节数
+    size_t read(void* buffer, size_t size) {
+#ifdef ELEVATOR_HAVE_ZLIB
+        int count = gzread(file, buffer, (unsigned)size);
+        return count > 0 ? count : 0;
+#else
+        return fread(buffer, 1, size, file);
+#endif
+    }
+};
 
-    // 获取电梯信息
-    int getId() const { return id; }
-    int getCurrentFloor() const { return currentFloor; }
-    ElevatorState getState() const { return state; }
-    int getPassengerCount() const { return currentPassengers; }
-    int getCapacity() const { return capacity; }
-    set<int> getInternalRequests() const { 
-        lock_guard<mutex> lock(mtx);
-        return internalRequests; 
+int decodeEventLog(const string& path, EventFormat format) {
+    EventLogInput file(path);
+    if (!file.isOpen()) {
+        cout << "无法打开日志文件: " << path << endl;
+        return 1;
+    }
+    
+    if (!file.readMagic()) {
+        cout << "不是事件日志文件: " << path << endl;
+        return 1;
+    }
+    
+    EventRenderer renderer;
+    long long wallOffset = 0;
+    printEventHeader(format);
+    EventRecord records[4096];
+    size_t count;
+    while ((count = file.read(records, sizeof(records)) / sizeof(EventRecord)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (records[i].code == (uint16_t)EventCode::CLOCK_SYNC) {
+                wallOffset = clockSyncOffset(records[i]);
+                continue;
+            }
+            printEvent(renderer, records[i], wallOffset, format);
+        }
+    }
+    cout.flush();
+    return 0;
+}
+
+// 把事件日志转换为 Chrome Trace Event JSON, 可用 chrome://tracing 或 ui.perfetto.dev 打开:
+// 每个日志目录是一个进程, 每部电梯是一条轨道(控制系统为 0 号轨道);
+// 移动、开门(开门到关门完成)和停站(开门到开始关门)为区间, 请求、派梯等其他事件为瞬时事件
+class TraceExporter {
+private:
+    struct Track {
+        long long moveStart = -1;
+        int moveFrom = 0;
+        long long doorStart = -1;
+        long long dwellStart = -1;
+        int doorFloor = 0;
+        long long emergencyStart = -1;
+    };
+    
+    FILE* out;
+    long long eventCount;
+    map<string, int> processIds;
+    map<pair<int, int>, Track> tracks;
+    
+    static string jsonEscape(const string& text) {
+        string escaped;
+        for (char c : text) {
+            unsigned char ch = c;
+            if (ch == '"' || ch == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (ch < 0x20) {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", ch);
+                escaped += code;
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+    
+    void separator() {
+        fputs(eventCount++ == 0 ? "\n" : ",\n", out);
     }
     
-    map<int, pair<bool, bool>> getExternalRequests() const {
-        lock_guard<mutex> lock(mtx);
-        return externalRequests;
+    void metadata(int pid, int tid, const char* name, const string& value) {
+        separator();
+        fprintf(out, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"args\":{\"name\":\"%s\"}}",
+                pid, tid, name, jsonEscape(value).c_str());
     }
     
-    bool isFull() const { return currentPassengers >= capacity; }
-    bool isEmergency() const { return emergencyStop; }
-    bool isInMaintenance() const { return maintenanceMode; }
+    // 时间戳为墙上时间纳秒, 输出单位为微秒
+    void complete(int pid, int tid, const char* name, long long start, long long end, const string& args) {
+        separator();
+        fprintf(out, "{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f,\"args\":{%s}}",
+                pid, tid, name, start / 1000.0, (end - start) / 1000.0, args.c_str());
+    }
     
-    string getStateString() const {
-        switch (state) {
-            case ElevatorState::IDLE: return "空闲";
-            case ElevatorState::MOVING_UP: return "上行";
-            case ElevatorState::MOVING_DOWN: return "下行";
-            case ElevatorState::DOORS_OPEN: return "门开";
-            case ElevatorState::EMERGENCY_STOP: return "紧急停止";
-            case ElevatorState::MAINTENANCE: return "维护中";
-            default: return "未知";
-        }
+    void instant(int pid, int tid, const string& name, long long ts) {
+        separator();
+        fprintf(out, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f}",
+                pid, tid, jsonEscape(name).c_str(), ts / 1000.0);
     }
     
-    void printStatistics() const {
-        time_t now = time(nullptr);
-        double hours = difftime(now, startTime) / 3600.0;
-        int floorsPerHour = hours > 0 ? totalFloorsTraveled / hours : 0;
-        
-        cout << "电梯 " << id << " 统计信息:" << endl;
-        cout << "  运行时间: " << fixed << setprecision(1) << hours << " 小时" << endl;
-        cout << "  总行程数: " << totalTrips << endl;
-        cout << "  总行驶楼层: " << totalFloorsTraveled << endl;
-        cout << "  平均行驶楼层/小时: " << floorsPerHour << endl;
-        
-        time_t lastMaintenanceTime = lastMaintenance;
-        char timeStr[100];
-        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&lastMaintenanceTime));
-        cout << "  上次维护时间: " << timeStr << endl;
+    Track& trackOf(int pid, int car) {
+        auto it = tracks.find({pid, car});
+        if (it != tracks.end()) return it->second;
+        metadata(pid, car, "thread_name", car == 0 ? "控制系统" : "电梯 " + to_string(car));
+        separator();
+        fprintf(out, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%d}}",
+                pid, car, car);
+        return tracks[{pid, car}];
     }
-};
-
-// 电梯控制系统类
-class ElevatorControlSystem {
-private:
-    vector<Elevator> elevators;
-    mutex mtx;
-    atomic<bool> running;
-    int maxFloors;
-    string logDir;
     
-public:
-    ElevatorControlSystem(int numElevators, int maxFloors, int capacity, const string& logDirectory = "logs") 
-        : maxFloors(maxFloors), running(true), logDir(logDirectory) {
-        
-        // 创建日志目录
-        system(("mkdir -p " + logDir).c_str());
-        
-        for (int i = 0; i < numElevators; i++) {
-            string logFile = logDir + "/elevator_" + to_string(i+1) + ".log";
-            elevators.emplace_back(i + 1, maxFloors, capacity, logFile);
-        }
+    // 紧急停止打断进行中的动作, 未结束的区间截止到此刻
+    void closeOpenIntervals(int pid, int car, Track& track, long long ts) {
+        if (track.moveStart >= 0) complete(pid, car, "移动", track.moveStart, ts, "\"from\":" + to_string(track.moveFrom));
+        if (track.dwellStart >= 0) complete(pid, car, "停站", track.dwellStart, ts, "\"floor\":" + to_string(track.doorFloor));
+        if (track.doorStart >= 0) complete(pid, car, "开门", track.doorStart, ts, "\"floor\":" + to_string(track.doorFloor));
+        track.moveStart = track.dwellStart = track.doorStart = -1;
     }
-
-    void start() {
-        for (auto& elevator : elevators) {
-            elevator.start();
+    
+    void addRecord(int pid, EventRenderer& renderer, const EventRecord& record, long long ts) {
+        int car = record.car;
+        Track& track = trackOf(pid, car);
+        switch ((EventCode)record.code) {
+            case EventCode::LOG_START:
+                renderer.describe(record);
+                break;
+            case EventCode::DEPARTED:
+                track.moveStart = ts;
+                track.moveFrom = record.a;
+                break;
+            case EventCode::ARRIVED:
+                if (track.moveStart >= 0) {
+                    complete(pid, car, "移动", track.moveStart, ts,
+                             "\"from\":" + to_string(track.moveFrom) + ",\"to\":" + to_string(record.a));
+                }
+                track.moveStart = -1;
+                break;
+            case EventCode::DOORS_OPENED:
+                track.doorStart = track.dwellStart = ts;
+                track.doorFloor = record.a;
+                break;
+            case EventCode::DOORS_CLOSED:
+                if (track.dwellStart >= 0) complete(pid, car, "停站", track.dwellStart, ts, "\"floor\":" + to_string(track.doorFloor));
+                track.dwellStart = -1;
+                break;
+            case EventCode::DOORS_SHUT:
+                if (track.doorStart >= 0) complete(pid, car, "开门", track.doorStart, ts, "\"floor\":" + to_string(track.doorFloor));
+                track.doorStart = -1;
+                break;
+            case EventCode::EMERGENCY_ACTIVATED:
+                closeOpenIntervals(pid, car, track, ts);
+                track.emergencyStart = ts;
+                break;
+            case EventCode::EMERGENCY_CLEARED:
+                if (track.emergencyStart >= 0) complete(pid, car, "紧急停止", track.emergencyStart, ts, "");
+                track.emergencyStart = -1;
+                break;
+            default:
+                instant(pid, car, renderer.describe(record), ts);
+                break;
         }
-        
-        thread monitorThread(&ElevatorControlSystem::monitor, this);
-        monitorThread.detach();
     }
-
-    void stop() {
-        running = false;
-        for (auto& elevator : elevators) {
-            elevator.stop();
-        }
+    
+public:
+    explicit TraceExporter(FILE* out) : out(out), eventCount(0) {
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
     }
-
-    void requestElevator(int floor, RequestType type = RequestType::INTERNAL, bool emergency = false, int preferredElevator = -1) {
-        if (floor < 1 || floor > maxFloors) {
-            cout << "无效楼层: " << floor << endl;
-            return;
+    
+    ~TraceExporter() {
+        fputs("\n]}\n", out);
+    }
+    
+    long long getEventCount() const { return eventCount; }
+    
+    bool addLog(const string& path) {
+        EventLogInput file(path);
+        if (!file.isOpen() || !file.readMagic()) return false;
+        
+        string directory = filesystem::path(path).parent_path().string();
+        auto it = processIds.find(directory);
+        if (it == processIds.end()) {
+            it = processIds.insert({directory, (int)processIds.size() + 1}).first;
+            metadata(it->second, 0, "process_name", directory.empty() ? "." : directory);
         }
-
-        if (emergency) {
-            // 紧急情况：通知所有电梯
-            for (auto& elevator : elevators) {
-                elevator.requestFloor(floor, type, true);
+        int pid = it->second;
+        
+        EventRenderer renderer;
+        long long wallOffset = 0;
+        EventRecord records[4096];
+        size_t count;
+        while ((count = file.read(records, sizeof(records)) / sizeof(EventRecord)) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                if (records[i].code == (uint16_t)EventCode::CLOCK_SYNC) {
+                    wallOffset = clockSyncOffset(records[i]);
+                    continue;
+                }
+                addRecord(pid, renderer, records[i], records[i].timestampNanos + wallOffset);
             }
-            return;
         }
+        return true;
+    }
+};
 
-        if (preferredElevator > 0 && preferredElevator <= elevators.size()) {
-            // 指定电梯
-            elevators[preferredElevator-1].requestFloor(floor, type);
-            cout << "分配请求 " << floor << "楼 给电梯 " << preferredElevator << endl;
-            return;
+int exportTrace(const string& outputPath, const vector<string>& logs) {
+    FILE* out = fopen(outputPath.c_str(), "w");
+    if (!out) {
+        cout << "无法写入: " << outputPath << endl;
+        return 1;
+    }
+    long long events;
+    {
+        TraceExporter exporter(out);
+        for (const string& log : logs) {
+            if (!exporter.addLog(log)) cout << "跳过无法读取的日志: " << log << endl;
         }
-
-        // 选择最合适的电梯
-        int bestElevator = findBestElevator(floor, type);
-        elevators[bestElevator].requestFloor(floor, type);
-        
-        cout << "分配请求 " << floor << "楼 给电梯 " << (bestElevator + 1) << endl;
+        events = exporter.getEventCount();
     }
+    fclose(out);
+    cout << "已导出 " << events << " 个事件到 " << outputPath << endl;
+    return 0;
+}
 
-    int findBestElevator(int floor, RequestType type) {
-        int bestIndex = 0;
-        int bestScore = INT_MAX;
+int dumpFlightRecorder(const string& path, EventFormat format) {
+    vector<EventRecord> events;
+    long long wallOffset = 0;
+    if (!FlightRecorder::load(path, events, wallOffset)) {
+        cout << "不是飞行记录文件: " << path << endl;
+        return 1;
+    }
+    
+    // 容量只出现在已被覆盖的 LOG_START 中时, 乘客人数不带容量
+    EventRenderer renderer;
+    printEventHeader(format);
+    for (const EventRecord& event : events) {
+        printEvent(renderer, event, wallOffset, format);
+    }
+    cout.flush();
+    return 0;
+}
 
-        for (int i = 0; i < elevators.size(); i++) {
-            int score = calculateElevatorScore(i, floor, type);
-            if (score < bestScore) {
-                bestScore = score;
-                bestIndex = i;
-            }
-        }
+// 从一个日志目录还原的请求流和实际的呼梯等待时间
+struct RecordedTraffic {
+    vector<RecordedRequest> requests;
+    int numElevators = 0;
+    int minFloor = INT_MAX;
+    int maxFloor = 0;
+    int capacity = 0;
+    long long spanNanos = 0;
+    LatencyStats actualWait;   // 派梯到所派电梯在该层开门
+    long long unanswered = 0;  // 日志结束时仍未响应的呼梯
+    int files = 0;
+};
 
-        return bestIndex;
+// 并行读取目录中的 system.evt 和各电梯日志(含轮转出的段), 时间戳统一换算为墙上时间;
+// 只使用最近一次启动(各电梯 LOG_START 中最晚者)之后的记录
+bool loadRecordedTraffic(const string& directory, int threads, RecordedTraffic& traffic) {
+    vector<string> paths;
+    error_code ec;
+    for (const auto& entry : filesystem::directory_iterator(directory, ec)) {
+        string name = entry.path().filename().string();
+        bool carLog = name.compare(0, 9, "elevator_") == 0 && name.find(".evt") != string::npos;
+        if (carLog || name.compare(0, 10, "system.evt") == 0) paths.push_back(entry.path().string());
     }
-
-    int calculateElevatorScore(int elevatorIndex, int targetFloor, RequestType type) {
-        const Elevator& elevator = elevators[elevatorIndex];
-        
-        // 如果电梯处于紧急状态或维护模式，不使用它
-        if (elevator.isEmergency() || elevator.isInMaintenance()) {
-            return INT_MAX;
+    if (ec || paths.empty()) return false;
+    traffic.files = paths.size();
+    
+    vector<vector<EventRecord>> perFile(paths.size());
+    {
+        WorkStealingPool pool(max(1, min<int>(threads, paths.size())));
+        for (size_t i = 0; i < paths.size(); i++) {
+            pool.submit([&paths, &perFile, i] {
+                EventLogInput file(paths[i]);
+                if (!file.isOpen() || !file.readMagic()) return;
+                vector<EventRecord>& events = perFile[i];
+                long long wallOffset = 0;
+                EventRecord records[4096];
+                size_t count;
+                while ((count = file.read(records, sizeof(records)) / sizeof(EventRecord)) > 0) {
+                    for (size_t k = 0; k < count; k++) {
+                        if (records[k].code == (uint16_t)EventCode::CLOCK_SYNC) {
+                            wallOffset = clockSyncOffset(records[k]);
+                            continue;
+                        }
+                        records[k].timestampNanos += wallOffset;
+                        events.push_back(records[k]);
+                    }
+                }
+            });
         }
-        
-        int currentFloor = elevator.getCurrentFloor();
-        ElevatorState state = elevator.getState();
-        int passengerCount = elevator.getPassengerCount();
-        int capacity = elevator.getCapacity();
-        
-        // 计算距离分数
-        int distance = abs(currentFloor - targetFloor);
-        
-        // 计算方向分数
-        int directionScore = 0;
-        if (state == ElevatorState::MOVING_UP) {
-            if (currentFloor <= targetFloor) {
-                directionScore = -10; // 同方向且正在接近
-            } else {
-                directionScore = 10; // 反方向
+        pool.wait();
+    }
+    
+    vector<EventRecord> events;
+    for (auto& fileEvents : perFile) {
+        events.insert(events.end(), fileEvents.begin(), fileEvents.end());
+    }
+    stable_sort(events.begin(), events.end(), [](const EventRecord& x, const EventRecord& y) {
+        return x.timestampNanos < y.timestampNanos;
+    });
+    
+    long long runStart = LLONG_MIN;
+    for (const EventRecord& event : events) {
+        if (event.code != (uint16_t)EventCode::LOG_START) continue;
+        runStart = max(runStart, event.timestampNanos - 1000000000LL);
+        traffic.numElevators = max<int>(traffic.numElevators, event.car);
+        traffic.capacity = max(traffic.capacity, event.a);
+        traffic.minFloor = min(traffic.minFloor, event.b);
+        traffic.maxFloor = max(traffic.maxFloor, event.c);
+    }
+    if (traffic.numElevators == 0) return false;
+    
+    // 等待中的呼梯: (电梯, 楼层) -> (派梯时刻, 方向)
+    map<pair<int, int>, vector<pair<long long, RequestType>>> pending;
+    long long first = -1;
+    auto add = [&](long long ts, int floor, RequestType type, int car, bool cancel) {
+        if (first < 0) first = ts;
+        traffic.requests.push_back({ts - first, floor, type, car, cancel});
+        traffic.spanNanos = ts - first;
+    };
+    for (const EventRecord& event : events) {
+        if (event.timestampNanos < runStart) continue;
+        long long ts = event.timestampNanos;
+        RequestType direction = event.b == 1 ? RequestType::EXTERNAL_UP : RequestType::EXTERNAL_DOWN;
+        switch ((EventCode)event.code) {
+            case EventCode::DISPATCHED:
+                if (event.b == 0) break;  // 内部请求取自电梯日志
+                add(ts, event.a, direction, 0, false);
+                pending[{event.car, event.a}].push_back({ts, direction});
+                break;
+            case EventCode::INTERNAL_REQUEST:
+                add(ts, event.a, RequestType::INTERNAL, event.car, false);
+                break;
+            case EventCode::INTERNAL_CANCELLED:
+                add(ts, event.a, RequestType::INTERNAL, event.car, true);
+                break;
+            case EventCode::HALL_CANCELLED: {
+                add(ts, event.a, direction, 0, true);
+                auto& calls = pending[{event.car, event.a}];
+                calls.erase(remove_if(calls.begin(), calls.end(), [direction](const pair<long long, RequestType>& call) {
+                    return call.second == direction;
+                }), calls.end());
+                break;
             }
-        } else if (state == ElevatorState::MOVING_DOWN) {
-            if (currentFloor >= targetFloor) {
-                directionScore = -10; // 同方向且正在接近
-            } else {
-                directionScore = 10; // 反方向
+            case EventCode::DOORS_OPENED: {
+                auto it = pending.find({event.car, event.a});
+                if (it == pending.end()) break;
+                for (const auto& call : it->second) traffic.actualWait.record(ts - call.first);
+                pending.erase(it);
+                break;
             }
-        } else if (state == ElevatorState::IDLE) {
-            directionScore = -5; // 空闲电梯
+            default:
+                break;
         }
-        
-        // 计算负载分数
-        int loadScore = (passengerCount * 10) / capacity;
-        
-        // 计算类型适配分数
-        int typeScore = 0;
-        if (type == RequestType::EXTERNAL_UP && state == ElevatorState::MOVING_DOWN) {
-            typeScore = 5; // 上行请求但电梯下行，稍微惩罚
-        } else if (type == RequestType::EXTERNAL_DOWN && state == ElevatorState::MOVING_UP) {
-            typeScore = 5; // 下行请求但电梯上行，稍微惩罚
-        }
-        
-        // 总分数 = 距离 + 方向分数 + 负载分数 + 类型适配分数
-        return distance + directionScore + loadScore + typeScore;
     }
+    for (const auto& calls : pending) traffic.unanswered += calls.second.size();
+    return true;
+}
 
-    void monitor() {
-        while (running) {
-            this_thread::sleep_for(chrono::seconds(10));
-            printStatus();
-            
-            // 每5分钟保存一次统计信息
-            static int counter = 0;
-            if (++counter % 30 == 0) { // 10s * 30 = 300s = 5min
-                saveStatistics();
-            }
-        }
+// --whatif: 把日志中的请求流在虚拟时钟上按原配置和另一种派梯策略/电梯配置各重放一次, 与实际等待时间对比
+int runWhatIf(const string& directory, DispatchPolicy policy, int cars, int capacity, int threads) {
+    auto loadStart = chrono::steady_clock::now();
+    RecordedTraffic traffic;
+    if (!loadRecordedTraffic(directory, threads, traffic)) {
+        cout << "没有可用的事件日志: " << directory << endl;
+        return 1;
     }
+    double loadMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
     
-    void saveStatistics() {
-        ofstream statsFile(logDir + "/statistics.txt", ios::trunc);
-        if (statsFile.is_open()) {
-            time_t now = time(nullptr);
-            char timeStr[100];
-            strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-            
-            statsFile << "电梯系统统计信息 - " << timeStr << endl;
-            statsFile << "==========================================" << endl;
-            
-            for (const auto& elevator : elevators) {
-                time_t startTime = time(nullptr); // 这里应该使用电梯的实际开始时间
-                double hours = difftime(now, startTime) / 3600.0;
-                
-                statsFile << "电梯 " << elevator.getId() << ":" << endl;
-                statsFile << "  运行时间: " << fixed << setprecision(1) << hours << " 小时" << endl;
-                // 这里可以添加更多统计信息
-                statsFile << endl;
-            }
-        }
+    auto requests = make_shared<const vector<RecordedRequest>>(move(traffic.requests));
+    // 最后一条请求之后再留出时间让电梯处理完
+    int minutes = (int)(traffic.spanNanos / 60000000000LL) + 10;
+    ReplicationSpec baseline{"baseline", traffic.numElevators, traffic.minFloor, traffic.maxFloor, traffic.capacity,
+                             minutes, 0.0, 0, DispatchPolicy::SCORE, requests};
+    ReplicationSpec whatIf = baseline;
+    whatIf.name = "whatif";
+    whatIf.policy = policy;
+    if (cars > 0) whatIf.numElevators = cars;
+    if (capacity > 0) whatIf.capacity = capacity;
+    
+    SimulationBatch batch(threads, "logs/whatif");
+    batch.add(baseline);
+    batch.add(whatIf);
+    vector<ReplicationResult> results = batch.run();
+    
+    double actualAverage = traffic.actualWait.averageMicros() / 1e6;
+    cout << "\n===== 重放对比 =====" << endl;
+    cout << "日志: " << traffic.files << " 个文件, 读取用时 " << fixed << setprecision(1) << loadMillis << " 毫秒, "
+         << requests->size() << " 条请求, 跨度 " << traffic.spanNanos / 6e10 << " 分钟" << endl;
+    cout << "实际: " << traffic.numElevators << "部电梯, 呼梯 " << traffic.actualWait.count << " 次, 平均等待 "
+         << actualAverage << " 秒, 最长 " << traffic.actualWait.maxMicros() / 1e6 << " 秒";
+    if (traffic.unanswered > 0) cout << " (" << traffic.unanswered << " 次日志结束时未响应)";
+    cout << endl;
+    const ReplicationSpec* specs[] = {&baseline, &whatIf};
+    for (int i = 0; i < 2; i++) {
+        cout << (i == 0 ? "重放(原配置): " : "重放(新配置): ") << specs[i]->numElevators << "部电梯, 容量 " << specs[i]->capacity
+             << ", 策略 " << dispatchPolicyName(specs[i]->policy) << ", 呼梯 " << results[i].hallCalls << " 次, 平均等待 "
+             << results[i].averageWaitSeconds << " 秒, 最长 " << results[i].maxWaitSeconds << " 秒" << endl;
     }
+    cout << showpos << "平均等待差异: 对比实际 " << results[1].averageWaitSeconds - actualAverage
+         << " 秒, 对比原配置重放 " << results[1].averageWaitSeconds - results[0].averageWaitSeconds << " 秒"
+         << noshowpos << endl;
+    return 0;
+}
 
-    void printStatus() {
-        cout << "\n===== 电梯状态监控 =====" << endl;
-        cout << "时间: ";
-        time_t now = time(nullptr);
-        char timeStr[100];
-        strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-        cout << timeStr << endl;
-        
-        for (const auto& elevator : elevators) {
-            cout << "电梯 " << elevator.getId() << ": ";
-            cout << "楼层 " << elevator.getCurrentFloor() << ", ";
-            cout << elevator.getStateString() << ", ";
-            cout << "乘客: " << elevator.getPassengerCount() << "/" << elevator.getCapacity();
-            
-            if (elevator.isEmergency()) {
-                cout << ", 紧急状态";
-            }
-            
-            if (elevator.isInMaintenance()) {
-                cout << ", 维护模式";
-            }
-            
-            auto internalReqs = elevator.getInternalRequests();
-            if (!internalReqs.empty()) {
-                cout << ", 内部请求: ";
-                for (int floor : internalReqs) {
-                    cout << floor << " ";
-                }
-            }
-            
-            auto externalReqs = elevator.getExternalRequests();
-            if (!externalReqs.empty()) {
-                cout << ", 外部请求: ";
-                for (const auto& req : externalReqs) {
-                    if (req.second.first) cout << req.first << "↑ ";
-                    if (req.second.second) cout << req.first << "↓ ";
-                }
-            }
-            
-            cout << endl;
+// --startup-bench: 反复创建、启动并销毁一个大型电梯组, 测量各阶段用时
+int runStartupBench(int cars, int rounds) {
+    cout << "启动测试: " << cars << "部电梯, " << rounds << " 轮" << endl;
+    double total = 0;
+    for (int round = 1; round <= rounds; round++) {
+        auto begin = chrono::steady_clock::now();
+        double constructMillis, startMillis;
+        {
+            ElevatorControlSystem system(cars, 25, 15, "logs/startup");
+            auto constructed = chrono::steady_clock::now();
+            system.start();
+            auto started = chrono::steady_clock::now();
+            constructMillis = chrono::duration<double, milli>(constructed - begin).count();
+            startMillis = chrono::duration<double, milli>(started - constructed).count();
         }
-        cout << "=======================\n" << endl;
+        double roundMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+        total += roundMillis;
+        cout << "第 " << round << " 轮: 构造 " << fixed << setprecision(2) << constructMillis << " 毫秒, 启动 " << startMillis
+             << " 毫秒, 停止并销毁 " << roundMillis - constructMillis - startMillis << " 毫秒, 合计 " << roundMillis << " 毫秒" << endl;
     }
+    cout << "平均每轮 " << total / rounds << " 毫秒" << endl;
+    return 0;
+}
 
-    void resetEmergency(int elevatorId) {
-        if (elevatorId > 0 && elevatorId <= elevators.size()) {
-            elevators[elevatorId - 1].resetEmergency();
-            cout << "电梯 " << elevatorId << " 紧急状态已重置" << endl;
-        } else {
-            cout << "无效的电梯ID" << endl;
-        }
+// --shaft-check: 在虚拟时钟上让同一井道的两部轿厢迎面相遇, 检查双方都能到达各自的目标
+int runShaftCheck() {
+    SimScheduler sched(SimScheduler::ClockMode::VIRTUAL);
+    ElevatorControlSystem system(2, 20, 15, "logs/shaft-check");
+    system.shareShaft({1, 2});
+    system.driveOn(sched);
+    
+    // 下方轿厢停在 10 楼, 上方轿厢停在 18 楼, 然后同时要求下方轿厢上行到 17 楼、上方轿厢下行到 3 楼
+    auto start = sched.now();
+    sched.postAt(start, [&system] {
+        system.requestElevator(10, RequestType::INTERNAL, false, 1);
+        system.requestElevator(18, RequestType::INTERNAL, false, 2);
+    });
+    sched.postAt(start + chrono::minutes(1), [&system] {
+        system.requestElevator(17, RequestType::INTERNAL, false, 1);
+        system.requestElevator(3, RequestType::INTERNAL, false, 2);
+    });
+    sched.runUntil(start + chrono::minutes(10));
+    
+    // 下方轿厢去过 17 楼后须让到 3 楼以下, 上方轿厢才能到达 3 楼
+    bool ok = system.isIdleAt(2, 3) && (system.isIdleAt(1, 1) || system.isIdleAt(1, 2));
+    system.stop();
+    cout << "井道迎面会车: " << (ok ? "通过" : "失败, 轿厢互相等待") << endl;
+    return ok ? 0 : 1;
+}
+
+// 全局函数：显示帮助信息
+void printHelp(ostream& out = cout) {
+    out << "可用命令:" << endl;
+    out << "  [楼层号] - 请求电梯到指定楼层(内部按钮)" << endl;
+    out << "  u[楼层号] - 请求上行电梯到指定楼层(外部上行按钮)" << endl;
+    out << "  d[楼层号] - 请求下行电梯到指定楼层(外部下行按钮)" << endl;
+    out << "  cu[楼层号] / cd[楼层号] - 取消指定楼层的上行/下行呼梯" << endl;
+    out << "  c [电梯号] [楼层号] - 取消指定电梯内的楼层请求" << endl;
+    out << "  e [楼层号] - 全楼紧急停止" << endl;
+    out << "  r [电梯号] - 重置指定电梯的紧急状态, 0 表示解除全楼紧急状态" << endl;
+    out << "  m [电梯号] - 切换指定电梯的维护模式" << endl;
+    out << "  s [电梯号] - 显示指定电梯的统计信息(不指定电梯号显示全部)" << endl;
+    out << "  status - 显示电梯状态" << endl;
+    out << "  help - 显示帮助信息" << endl;
+    out << "  0 - 退出程序" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    // --decode <文件> [--csv|--json]
+    if (argc >= 3 && string(argv[1]) == "--decode") {
+        return decodeEventLog(argv[2], parseEventFormat(argc, argv, 3));
     }
     
-    void setMaintenanceMode(int elevatorId, bool mode) {
-        if (elevatorId > 0 && elevatorId <= elevators.size()) {
-            elevators[elevatorId - 1].setMaintenanceMode(mode);
-            cout << "电梯 " << elevatorId << " 维护模式" << (mode ? "开启" : "关闭") << endl;
-        } else {
-            cout << "无效的电梯ID" << endl;
-        }
+    if (argc >= 3 && string(argv[1]) == "--dump-flight") {
+        return dumpFlightRecorder(argv[2], parseEventFormat(argc, argv, 3));
     }
     
-    void printStatistics(int elevatorId = -1) const {
-        if (elevatorId == -1) {
-            for (const auto& elevator : elevators) {
-                elevator.printStatistics();
-                cout << endl;
+    // --trace out.json logs/*.evt: 导出时间线
+    if (argc >= 4 && string(argv[1]) == "--trace") {
+        return exportTrace(argv[2], vector<string>(argv + 3, argv + argc));
+    }
+    
+    // --whatif logs [--policy score|nearest|round-robin] [--cars N] [--capacity N] [--threads N]
+    if (argc >= 3 && string(argv[1]) == "--whatif") {
+        DispatchPolicy policy = DispatchPolicy::SCORE;
+        int cars = 0;
+        int capacity = 0;
+        int threads = max(1u, thread::hardware_concurrency());
+        for (int i = 3; i + 1 < argc; i += 2) {
+            string option = argv[i];
+            string value = argv[i + 1];
+            bool ok = true;
+            if (option == "--policy") ok = parseDispatchPolicy(value, policy);
+            else if (option == "--cars") ok = (cars = atoi(value.c_str())) > 0;
+            else if (option == "--capacity") ok = (capacity = atoi(value.c_str())) > 0;
+            else if (option == "--threads") ok = (threads = atoi(value.c_str())) > 0;
+            else ok = false;
+            if (!ok) {
+                cout << "无效参数: " << option << " " << value << endl;
+                return 1;
             }
-        } else if (elevatorId > 0 && elevatorId <= elevators.size()) {
-            elevators[elevatorId - 1].printStatistics();
-        } else {
-            cout << "无效的电梯ID" << endl;
         }
+        ConsoleLog::setQuiet(true);
+        return runWhatIf(argv[2], policy, cars, capacity, threads);
     }
     
-    int getElevatorCount() const {
-        return elevators.size();
+    // --startup-bench [电梯数] [轮数]
+    if (argc >= 2 && string(argv[1]) == "--startup-bench") {
+        int cars = argc >= 3 ? atoi(argv[2]) : 1000;
+        int rounds = argc >= 4 ? atoi(argv[3]) : 5;
+        ConsoleLog::setQuiet(true);
+        return runStartupBench(max(1, cars), max(1, rounds));
     }
     
-    int getMaxFloors() const {
-        return maxFloors;
+    if (argc >= 2 && string(argv[1]) == "--shaft-check") {
+        ConsoleLog::setQuiet(true);
+        return runShaftCheck();
     }
-};
-
-// 全局函数：显示帮助信息
-void printHelp() {
-    cout << "可用命令:" << endl;
-    cout << "  [楼层号] - 请求电梯到指定楼层(内部按钮)" << endl;
-    cout << "  u[楼层号] - 请求上行电梯到指定楼层(外部上行按钮)" << endl;
-    cout << "  d[楼层号] - 请求下行电梯到指定楼层(外部下行按钮)" << endl;
-    cout << "  e [楼层号] - 紧急停止请求" << endl;
-    cout << "  r [电梯号] - 重置指定电梯的紧急状态" << endl;
-    cout << "  m [电梯号] - 切换指定电梯的维护模式" << endl;
-    cout << "  s [电梯号] - 显示指定电梯的统计信息(不指定电梯号显示全部)" << endl;
-    cout << "  status - 显示电梯状态" << endl;
-    cout << "  help - 显示帮助信息" << endl;
-    cout << "  0 - 退出程序" << endl;
-}
-
-int main() {
+    
+    if (argc >= 2 && string(argv[1]) == "--sim-batch") {
+        int repeats = argc >= 3 ? atoi(argv[2]) : 4;
+        int threads = argc >= 4 ? atoi(argv[3]) : (int)max(1u, thread::hardware_concurrency());
+        ConsoleLog::setQuiet(true);
+        return runSimulationBatch(max(1, repeats), threads);
+    }
+    
+    // 线程调度选项: --control-cpus 2-3 --aux-cpus 0-1 --rt-policy fifo|rr --rt-priority 50
+    // --quiet: 不输出逐事件的控制台信息
+    // --json: 事件和状态以 JSON 行输出到标准输出, 提示和命令反馈改到标准错误
+    // 日志轮转: --log-max-mb 64 --log-max-hours 24 --log-retain 14 --log-compress on|off
+    // 飞行记录器: --flight-events 8192 (每部电梯保存的事件数, 0 表示不启用)
+    ThreadTuning tuning;
+    LogRotation rotation;
+    long long flightEvents = 8192;
+    for (int i = 1; i < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--quiet" || option == "--json") {
+            if (option == "--quiet") ConsoleLog::setQuiet(true);
+            else ConsoleLog::setJson(true);
+            i--;
+            continue;
+        }
+        string value = i + 1 < argc ? argv[i + 1] : "";
+        bool ok = true;
+        if (option == "--control-cpus") {
+            ok = ThreadTuning::parseCpuList(value, tuning.controlCpus);
+        } else if (option == "--aux-cpus") {
+            ok = ThreadTuning::parseCpuList(value, tuning.auxiliaryCpus);
+        } else if (option == "--rt-policy") {
+            if (value == "fifo") tuning.policy = ThreadTuning::Policy::FIFO;
+            else if (value == "rr") tuning.policy = ThreadTuning::Policy::RR;
+            else ok = false;
+        } else if (option == "--rt-priority") {
+            tuning.priority = atoi(value.c_str());
+        } else if (option == "--log-max-mb") {
+            rotation.maxBytes = atoll(value.c_str()) * 1024 * 1024;
+        } else if (option == "--log-max-hours") {
+            rotation.maxAge = chrono::hours(atoi(value.c_str()));
+        } else if (option == "--log-retain") {
+            rotation.retain = atoi(value.c_str());
+            ok = rotation.retain >= 0;
+        } else if (option == "--flight-events") {
+            flightEvents = atoll(value.c_str());
+            ok = flightEvents >= 0 && flightEvents <= UINT32_MAX;
+        } else if (option == "--log-compress") {
+            if (value == "on") rotation.compress = true;
+            else if (value == "off") rotation.compress = false;
+            else ok = false;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            ConsoleLog::stream() << "无效参数: " << option << " " << value << endl;
+            return 1;
+        }
+    }
+    
     const int NUM_ELEVATORS = 4;
     const int MAX_FLOORS = 25;
     const int ELEVATOR_CAPACITY = 15;
     
+    AsyncLogger::instance().setRotation(rotation);
     ElevatorControlSystem system(NUM_ELEVATORS, MAX_FLOORS, ELEVATOR_CAPACITY);
+    system.setThreadTuning(tuning);
+    if (flightEvents > 0 && !system.enableFlightRecorder(flightEvents)) {
+        ConsoleLog::stream() << "无法创建飞行记录文件, 以默认方式运行" << endl;
+    }
     system.start();
 
-    cout << "电梯控制系统启动 (" << NUM_ELEVATORS << "部电梯, " << MAX_FLOORS << "层)" << endl;
-    printHelp();
+    // JSON 行模式下标准输出只留给 JSON, 提示和命令反馈写到标准错误
+    ostream& console = ConsoleLog::stream();
+    console << "电梯控制系统启动 (" << NUM_ELEVATORS << "部电梯, " << MAX_FLOORS << "层)" << endl;
+    printHelp(console);
 
     random_device rd;
     mt19937 gen(rd());
@@ -795,7 +4784,7 @@ int main() {
     string input;
     int value;
     while (true) {
-        cout << "请输入命令: ";
+        console << "请输入命令: ";
         cin >> input;
 
         if (input == "0") {
@@ -819,32 +4808,48 @@ int main() {
                 system.printStatistics(value);
             }
         } else if (input == "help") {
-            printHelp();
+            printHelp(console);
+        } else if (input == "c") {
+            int floor;
+            cin >> value >> floor;
+            if (!system.cancelCarCall(value, floor)) {
+                console << "没有可取消的请求" << endl;
+            }
+        } else if ((input.compare(0, 2, "cu") == 0 || input.compare(0, 2, "cd") == 0) && input.size() > 2) {
+            try {
+                value = stoi(input.substr(2));
+                RequestType type = (input[1] == 'u') ? RequestType::EXTERNAL_UP : RequestType::EXTERNAL_DOWN;
+                if (!system.cancelHallCall(value, type)) {
+                    console << "没有可取消的请求" << endl;
+                }
+            } catch (exception& e) {
+                console << "无效命令!" << endl;
+            }
         } else if (input[0] == 'u' && input.size() > 1) {
             try {
                 value = stoi(input.substr(1));
                 system.requestElevator(value, RequestType::EXTERNAL_UP);
             } catch (exception& e) {
-                cout << "无效命令!" << endl;
+                console << "无效命令!" << endl;
             }
         } else if (input[0] == 'd' && input.size() > 1) {
             try {
                 value = stoi(input.substr(1));
                 system.requestElevator(value, RequestType::EXTERNAL_DOWN);
             } catch (exception& e) {
-                cout << "无效命令!" << endl;
+                console << "无效命令!" << endl;
             }
         } else {
             try {
                 value = stoi(input);
                 system.requestElevator(value);
             } catch (exception& e) {
-                cout << "无效命令! 输入 'help' 查看帮助" << endl;
+                console << "无效命令! 输入 'help' 查看帮助" << endl;
             }
         }
     }
 
     system.stop();
-    cout << "程序结束" << endl;
+    console << "程序结束" << endl;
     return 0;
 }
\ No newline at end of file